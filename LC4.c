@@ -3,6 +3,8 @@
  */
 
 #include "LC4.h"
+#include "cache.h"
+#include "recorder.h"
 #include <stdio.h>
 
 #define INSN_OP(I) ((I) >> 12) // EXTRACTS [15:12]
@@ -23,6 +25,24 @@
 #define INSN_last_8(I) ((I) & 0xFF);
 #define INSN_mod_shift_type(I) (((I) >> 4) & 0x3);
 
+// Fusion table entries, one per address: what the pair starting there fuses into
+#define FUSE_UNKNOWN 0
+#define FUSE_NONE 1
+#define FUSE_CONST_HICONST 2
+#define FUSE_CMP_BR 3
+#define FUSE_LDR_ADD 4
+
+static int invalidPC(MachineState* CPU, unsigned short pc);
+static int raiseFault(MachineState* CPU, int fault, const char* message);
+static void loadConst(MachineState* CPU, unsigned short insn);
+static void loadHiConst(MachineState* CPU, unsigned short insn);
+static int loadWord(MachineState* CPU, unsigned short insn);
+static void readKeyboard(MachineState* CPU);
+static unsigned short branchTarget(MachineState* CPU, unsigned short insn);
+static void arithmetic(MachineState* CPU, unsigned short insn);
+static void compare(MachineState* CPU, unsigned short insn);
+static int runFused(MachineState* CPU);
+
 /*
  * Reset the machine state as Pennsim would do
  */
@@ -37,6 +57,12 @@ void Reset(MachineState* CPU)
 
   CPU -> PC = 0x8200;
   CPU -> PSR = 0x8002;
+  CPU -> icache = NULL;
+  CPU -> dcache = NULL;
+  CPU -> fuseTable = NULL;
+  CPU -> recorder = NULL;
+  CPU -> keyboard = NULL;
+  CPU -> fault = FAULT_NONE;
   ClearSignals(CPU);
 }
 
@@ -74,16 +100,52 @@ void WriteOut(MachineState* CPU, FILE* output)
 8. the data WE
 9. if data WE is high, the data memory address
 10. if data WE is high, what value is being loaded or stored into memory*/
-  unsigned short inst = CPU -> memory[CPU -> PC];
-  fprintf(output, "%04X ", CPU -> PC);
+  if (CPU -> recorder != NULL) {
+    RecordCycle(CPU -> recorder, CPU);
+  }
+  if (output == NULL) {
+    return;
+  }
+  TraceRecord record;
+  CaptureRecord(CPU, &record);
+  WriteRecord(&record, output);
+}
+
+
+/*
+ * Copy the values WriteOut would print into record.
+ */
+void CaptureRecord(MachineState* CPU, TraceRecord* record)
+{
+  record -> PC = CPU -> PC;
+  record -> insn = CPU -> memory[CPU -> PC];
+  record -> regFile_WE = CPU -> regFile_WE;
+  record -> rdMux_CTL = CPU -> rdMux_CTL;
+  record -> NZP_WE = CPU -> NZP_WE;
+  record -> DATA_WE = CPU -> DATA_WE;
+  record -> regInputVal = CPU -> regInputVal;
+  record -> NZPVal = CPU -> NZPVal;
+  record -> dmemAddr = CPU -> dmemAddr;
+  record -> dmemValue = CPU -> dmemValue;
+  record -> fault = CPU -> fault;
+}
+
+
+/*
+ * Write one captured record to output in the same format as WriteOut.
+ */
+void WriteRecord(TraceRecord* record, FILE* output)
+{
+  unsigned short inst = record -> insn;
+  fprintf(output, "%04X ", record -> PC);
   for (int i = 15; i >= 0; i--) {
     int bit = (inst >> i) % 2;
     fprintf(output, "%d", bit);
   }
   fprintf(output, " ");
-  fprintf(output, "%X ", CPU -> regFile_WE);
-  if (CPU -> regFile_WE == 1) {
-    if (CPU -> rdMux_CTL == 0) {
+  fprintf(output, "%X ", record -> regFile_WE);
+  if (record -> regFile_WE == 1) {
+    if (record -> rdMux_CTL == 0) {
       fprintf(output, "%X ", INSN_dest(inst));
     } else {
       fprintf(output, "7 ");
@@ -91,23 +153,23 @@ void WriteOut(MachineState* CPU, FILE* output)
   } else {
     fprintf(output, "0 ");
   }
-  if (CPU -> regFile_WE == 1) {
-    fprintf(output, "%04X ", CPU -> regInputVal);
+  if (record -> regFile_WE == 1) {
+    fprintf(output, "%04X ", record -> regInputVal);
   } else {
     fprintf(output, "0000 ");
   }
-  unsigned short nzp_we = CPU -> NZP_WE;
+  unsigned short nzp_we = record -> NZP_WE;
   fprintf(output, "%X ", nzp_we);
   if (nzp_we == 1) {
-    fprintf(output, "%X ", CPU -> NZPVal);
+    fprintf(output, "%X ", record -> NZPVal);
   } else {
     fprintf(output, "0 ");
   }
-  unsigned short data_we = CPU -> DATA_WE;
+  unsigned short data_we = record -> DATA_WE;
   fprintf(output, "%X ", data_we);
   if (data_we == 1) {
-    fprintf(output, "%04X ", CPU -> dmemAddr);
-    fprintf(output, "%04X", CPU -> dmemValue);
+    fprintf(output, "%04X ", record -> dmemAddr);
+    fprintf(output, "%04X", record -> dmemValue);
   } else {
     fprintf(output, "0000 ");
     fprintf(output, "0000");
@@ -123,13 +185,30 @@ int extendSign(unsigned short num, int len) {
 }
 
 
+// true if pc is outside the code regions the current privilege level may run
+static int invalidPC(MachineState* CPU, unsigned short pc) {
+  unsigned short bit = CPU -> PSR >> 15;
+  return (pc >= 0x2000 && pc <= 0x7FFF) || 
+  (pc >= 0x8000 && bit == 0) || (pc >= 0xA000 && bit == 1);
+}
+
+// report a fault that ends the run; the cycle prints nothing, but the flight
+// recorder keeps it so a dump ends with the instruction that faulted
+static int raiseFault(MachineState* CPU, int fault, const char* message) {
+  printf("%s", message);
+  CPU -> fault = fault;
+  if (CPU -> recorder != NULL) {
+    RecordCycle(CPU -> recorder, CPU);
+  }
+  return -1;
+}
+
 void setPC(MachineState* CPU, short pc, FILE* output) {
   unsigned short new_pc = pc + 1;
-  unsigned short bit = CPU -> PSR >> 15;
   WriteOut(CPU, output);
-  if ((new_pc >= 0x2000 && new_pc <= 0x7FFF) || 
-  (new_pc >= 0X8000 && bit == 0) || (new_pc >= 0XA000 && bit == 1)) {
+  if (invalidPC(CPU, new_pc)) {
     printf("Invalid PC, setting to default");
+    CPU -> fault = FAULT_INVALID_PC;
     CPU -> PC = 0x80FF;
   } else {
     CPU -> PC = new_pc;
@@ -137,10 +216,9 @@ void setPC(MachineState* CPU, short pc, FILE* output) {
 }
 
 void checkOOB(MachineState* CPU, unsigned short pc, FILE* output) {
-  unsigned short bit = CPU -> PSR >> 15;
-  if ((pc >= 0x2000 && pc <= 0x7FFF) || 
-  (pc >= 0x8000 && bit == 0) || (pc >= 0xA000 && bit == 1)) {
+  if (invalidPC(CPU, pc)) {
     printf("Invalid PC, setting to default");
+    CPU -> fault = FAULT_INVALID_PC;
     CPU -> PC = 0x80FF;
   } else {
     CPU -> PC = pc;
@@ -152,17 +230,28 @@ void checkOOB(MachineState* CPU, unsigned short pc, FILE* output) {
  */
 int UpdateMachineState(MachineState* CPU, FILE* output)
 {
+  // with tracing off and no models attached, common pairs run as one step
+  if (output == NULL && CPU -> fuseTable != NULL && CPU -> icache == NULL && CPU -> dcache == NULL &&
+  CPU -> recorder == NULL) {
+    int result = runFused(CPU);
+    if (result != 0) {
+      return (result == -1) ? -1 : 2;
+    }
+  }
+
   unsigned short pc = CPU -> memory[CPU -> PC];
   unsigned short operation = INSN_OP(pc);
   unsigned short special_op = INSN_OP_5bit(pc);
-  unsigned short dest = INSN_dest(pc);
   unsigned short t_reg = INSN_t(pc);
   unsigned short s_reg = INSN_s(pc);
   unsigned short last_6 = INSN_last_6(pc);
-  signed short last_9 = INSN_last_9(pc);
   unsigned short last_8 = INSN_last_8(pc);
   unsigned short bit = (CPU -> PSR) >> 15;
 
+  if (CPU -> icache != NULL) {
+    CacheAccess(CPU -> icache, CPU -> PC, CPU -> PC, 0);
+  }
+
   switch (operation) {
     case 0:
       BranchOp(CPU, output);
@@ -193,47 +282,28 @@ int UpdateMachineState(MachineState* CPU, FILE* output)
       if (((CPU -> dmemAddr <= 0x7FFF) && (CPU -> dmemAddr >= 0x2000)) || 
       ((CPU -> dmemAddr <= 0xFFFF) && (CPU -> dmemAddr >= 0xA000) && bit == 1)) {
         CPU -> memory[CPU -> dmemAddr] = CPU -> dmemValue;
+        InvalidateFusion(CPU, CPU -> dmemAddr);
+        if (CPU -> dcache != NULL) {
+          CacheAccess(CPU -> dcache, CPU -> PC, CPU -> dmemAddr, 1);
+        }
         SetNZP(CPU, CPU -> regInputVal);
         setPC(CPU, CPU -> PC, output);
       } else {
-        printf("Invalid memory address");
-        return -1;
+        return raiseFault(CPU, FAULT_INVALID_ADDRESS, "Invalid memory address");
       }
       break;
    case 6: //ldr
-      CPU -> regFile_WE = 1;
-      CPU -> NZP_WE = 1;
-      CPU -> DATA_WE = 0;
-      CPU -> dmemAddr = (CPU -> R[s_reg]) + extendSign(last_6, 6);
-      CPU -> dmemValue = CPU -> memory[CPU -> dmemAddr];
-      CPU -> regInputVal = CPU -> dmemValue;
-      if (((CPU -> dmemAddr <= 0x7FFF) && (CPU -> dmemAddr >= 0x2000)) || 
-      ((CPU -> dmemAddr <= 0xFFFF) && (CPU -> dmemAddr >= 0xA000) && bit == 1)) {
-        CPU -> R[dest] = CPU -> regInputVal;
-        CPU -> rsMux_CTL = 0;
-        SetNZP(CPU, CPU -> regInputVal);
-        setPC(CPU, CPU -> PC, output);
-      } else {
-        printf("Invalid memory address");
-        return -1;
+      if (loadWord(CPU, pc) == -1) {
+        return raiseFault(CPU, FAULT_INVALID_ADDRESS, "Invalid memory address");
       }
+      setPC(CPU, CPU -> PC, output);
       break;
    case 9: //const
-      CPU -> regFile_WE = 1;
-      CPU -> rdMux_CTL = 0;
-      CPU -> NZP_WE = 1;
-      CPU -> regInputVal = extendSign(last_9, 9);
-      CPU -> R[dest] = CPU -> regInputVal;
-      SetNZP(CPU, CPU -> regInputVal);
+      loadConst(CPU, pc);
       setPC(CPU, CPU -> PC, output);
       break;
    case 13: //hiconst
-      CPU -> regFile_WE = 1;
-      CPU -> rsMux_CTL = 1;
-      CPU -> NZP_WE = 1;
-      CPU -> regInputVal = ((CPU -> R[dest]) & 0xFF) | extendSign(last_8, 8);
-      CPU -> R[dest] = CPU -> regInputVal;
-      SetNZP(CPU, CPU -> regInputVal);
+      loadHiConst(CPU, pc);
       setPC(CPU, CPU -> PC, output);
       break;
    case 15: //trap
@@ -259,10 +329,9 @@ int UpdateMachineState(MachineState* CPU, FILE* output)
       checkOOB(CPU, CPU -> PC, output);
       break;
    default:
-      printf("Invalid instruction");
-      return -1;
+      return raiseFault(CPU, FAULT_INVALID_INSN, "Invalid instruction");
   }
-  return 0;
+  return 1;
 }
 
 
@@ -270,6 +339,77 @@ int UpdateMachineState(MachineState* CPU, FILE* output)
 //////////////// PARSING HELPER FUNCTIONS ///////////////////////////
 
 
+// CONST: sets the register file signals and writes the sign extended IMM9
+static void loadConst(MachineState* CPU, unsigned short insn) {
+  unsigned short dest = INSN_dest(insn);
+  unsigned short last_9 = INSN_last_9(insn);
+  CPU -> regFile_WE = 1;
+  CPU -> rdMux_CTL = 0;
+  CPU -> NZP_WE = 1;
+  CPU -> regInputVal = extendSign(last_9, 9);
+  CPU -> R[dest] = CPU -> regInputVal;
+  SetNZP(CPU, CPU -> regInputVal);
+}
+
+// HICONST: sets the register file signals and merges IMM8 into the destination
+static void loadHiConst(MachineState* CPU, unsigned short insn) {
+  unsigned short dest = INSN_dest(insn);
+  unsigned short last_8 = INSN_last_8(insn);
+  CPU -> regFile_WE = 1;
+  CPU -> rsMux_CTL = 1;
+  CPU -> NZP_WE = 1;
+  CPU -> regInputVal = ((CPU -> R[dest]) & 0xFF) | extendSign(last_8, 8);
+  CPU -> R[dest] = CPU -> regInputVal;
+  SetNZP(CPU, CPU -> regInputVal);
+}
+
+// refresh the keyboard register LDR is about to read, if it reads one
+static void readKeyboard(MachineState* CPU) {
+  Keyboard* keyboard = CPU -> keyboard;
+  if (CPU -> dmemAddr == KBSR) {
+    if (keyboard -> next < keyboard -> length) {
+      CPU -> memory[KBSR] = 0x8000;
+    } else {
+      CPU -> memory[KBSR] = 0;
+      keyboard -> drained = 1;
+    }
+  } else if (CPU -> dmemAddr == KBDR) {
+    if (keyboard -> next < keyboard -> length) {
+      CPU -> memory[KBDR] = keyboard -> keys[keyboard -> next++];
+      CPU -> memory[KBSR] = 0;
+    }
+  }
+}
+
+// LDR: loads into the destination, or returns -1 if the address may not be read
+static int loadWord(MachineState* CPU, unsigned short insn) {
+  unsigned short dest = INSN_dest(insn);
+  unsigned short s_reg = INSN_s(insn);
+  unsigned short last_6 = INSN_last_6(insn);
+  unsigned short bit = (CPU -> PSR) >> 15;
+  CPU -> regFile_WE = 1;
+  CPU -> NZP_WE = 1;
+  CPU -> DATA_WE = 0;
+  CPU -> dmemAddr = (CPU -> R[s_reg]) + extendSign(last_6, 6);
+  if (CPU -> keyboard != NULL && bit == 1) {
+    readKeyboard(CPU);
+  }
+  CPU -> dmemValue = CPU -> memory[CPU -> dmemAddr];
+  CPU -> regInputVal = CPU -> dmemValue;
+  if (((CPU -> dmemAddr <= 0x7FFF) && (CPU -> dmemAddr >= 0x2000)) || 
+  ((CPU -> dmemAddr <= 0xFFFF) && (CPU -> dmemAddr >= 0xA000) && bit == 1)) {
+    CPU -> R[dest] = CPU -> regInputVal;
+    CPU -> rsMux_CTL = 0;
+    if (CPU -> dcache != NULL) {
+      CacheAccess(CPU -> dcache, CPU -> PC, CPU -> dmemAddr, 0);
+    }
+    SetNZP(CPU, CPU -> regInputVal);
+    return 0;
+  }
+  return -1;
+}
+
+
 
 /*
  * Parses rest of branch operation and updates state of machine.
@@ -280,62 +420,71 @@ void BranchOp(MachineState* CPU, FILE* output)
   CPU -> DATA_WE = 0;
   CPU -> regFile_WE = 0;
   unsigned short pc = CPU -> memory[CPU -> PC];
-  unsigned short type = INSN_dest(pc);
-  signed short last_9 = INSN_last_9(pc);
-  unsigned short nzp = CPU -> PSR & 0X7;
   
   WriteOut(CPU, output);
+  CPU -> PC = branchTarget(CPU, pc);
+  SetNZP(CPU, CPU -> regInputVal);
+  checkOOB(CPU, CPU -> PC, output);
+}
+
+// the PC a branch moves to, given the NZP bits currently in the PSR
+static unsigned short branchTarget(MachineState* CPU, unsigned short insn)
+{
+  unsigned short type = INSN_dest(insn);
+  signed short last_9 = INSN_last_9(insn);
+  unsigned short nzp = CPU -> PSR & 0X7;
+  unsigned short next = CPU -> PC;
+
   switch (type){
     case 0: 
       break;
     case 4: 
       if ((nzp & 0x4) == 4) {
-        CPU -> PC = (CPU -> PC) + 1 + extendSign(last_9, 9);
+        next = next + 1 + extendSign(last_9, 9);
       } else {
-        CPU -> PC = (CPU -> PC) + 1;
+        next = next + 1;
       }
       break;
     case 6: 
       if (((nzp & 0x6) == 6) || ((nzp & 0x6) == 4) || ((nzp & 0x6) == 2)) {
-        CPU -> PC = (CPU -> PC) + 1 + extendSign(last_9, 9);
+        next = next + 1 + extendSign(last_9, 9);
       } else {
-        CPU -> PC = (CPU -> PC) + 1;
+        next = next + 1;
       }
       break;
    case 5: 
       if (((nzp & 0x5) == 5) || ((nzp & 0x5) == 4) || ((nzp & 0x5) == 1)) {
-        CPU -> PC = (CPU -> PC) + 1 + extendSign(last_9, 9);
+        next = next + 1 + extendSign(last_9, 9);
       } else {
-        CPU -> PC = (CPU -> PC) + 1;
+        next = next + 1;
       }
       break;
     case 2: 
       if ((nzp & 0x2) == 2) {
-        CPU -> PC = (CPU -> PC) + 1 + extendSign(last_9, 9);
+        next = next + 1 + extendSign(last_9, 9);
       } else {
-        CPU -> PC = (CPU -> PC) + 1;
+        next = next + 1;
       }
       break;
     case 3: 
       if (((nzp & 0x3) == 3) || ((nzp & 0x3) == 1) || ((nzp & 0x3) == 2)) {
-        CPU -> PC = (CPU -> PC) + 1 + extendSign(last_9, 9);
+        next = next + 1 + extendSign(last_9, 9);
       }
       break;
     case 1: 
       if ((nzp & 0x1) == 1) {
-        CPU -> PC = (CPU -> PC) + 1 + extendSign(last_9, 9);
+        next = next + 1 + extendSign(last_9, 9);
       } else {
-        CPU -> PC = (CPU -> PC) + 1;
+        next = next + 1;
       }
       break;
     case 7: 
-      CPU -> PC = (CPU -> PC) + 1 + extendSign(last_9, 9);
+      next = next + 1 + extendSign(last_9, 9);
       break;
    default:
       printf("Invalid branch operation");
   }
-  SetNZP(CPU, CPU -> regInputVal);
-  checkOOB(CPU, CPU -> PC, output);
+  return next;
 }
 
 /*
@@ -343,7 +492,13 @@ void BranchOp(MachineState* CPU, FILE* output)
  */
 void ArithmeticOp(MachineState* CPU, FILE* output)
 {
-  unsigned short pc = CPU -> memory[CPU -> PC];
+  arithmetic(CPU, CPU -> memory[CPU -> PC]);
+  setPC(CPU, CPU -> PC, output);
+}
+
+// ADD/MUL/SUB/DIV without the PC update
+static void arithmetic(MachineState* CPU, unsigned short pc)
+{
   unsigned short type = INSN_ar_type(pc);
   unsigned short dest = INSN_dest(pc);
   unsigned short t_reg = INSN_t(pc);
@@ -381,7 +536,6 @@ void ArithmeticOp(MachineState* CPU, FILE* output)
       printf("Invalid arithmetic operation");
   }
   SetNZP(CPU, CPU -> regInputVal);
-  setPC(CPU, CPU -> PC, output);
 }
 
 /*
@@ -389,7 +543,14 @@ void ArithmeticOp(MachineState* CPU, FILE* output)
  */
 void ComparativeOp(MachineState* CPU, FILE* output)
 {
-  unsigned short pc = CPU -> memory[CPU -> PC];
+  compare(CPU, CPU -> memory[CPU -> PC]);
+  setPC(CPU, CPU -> PC, output);
+  //WriteOut(CPU, output);
+}
+
+// CMP/CMPU/CMPI/CMPIU without the PC update
+static void compare(MachineState* CPU, unsigned short pc)
+{
   unsigned short type = INSN_comp_type(pc);
   unsigned short s_reg = INSN_dest(pc);
   unsigned short t_reg = INSN_t(pc);
@@ -418,8 +579,6 @@ void ComparativeOp(MachineState* CPU, FILE* output)
       printf("Invalid comparative operation");
   }
   SetNZP(CPU, CPU -> regInputVal);
-  setPC(CPU, CPU -> PC, output);
-  //WriteOut(CPU, output);
 }
 
 /*
@@ -584,3 +743,110 @@ void SetNZP(MachineState* CPU, short result) {
     }
     CPU -> NZPVal = CPU -> PSR & 0x7;
 }
+
+
+
+//////////////// FUSED INSTRUCTION PAIRS ///////////////////////////
+
+
+
+/*
+ * Start fusing instruction pairs when running with tracing off.
+ */
+int EnableFusion(MachineState* CPU)
+{
+  CPU -> fuseTable = calloc(65536, sizeof(unsigned char));
+  if (CPU -> fuseTable == NULL) {
+    printf("could not allocate fusion table");
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Stop fusing and release the fusion table.
+ */
+void DisableFusion(MachineState* CPU)
+{
+  free(CPU -> fuseTable);
+  CPU -> fuseTable = NULL;
+}
+
+/*
+ * Forget the pairs that include the word at addr, which is about to change.
+ */
+void InvalidateFusion(MachineState* CPU, unsigned short addr)
+{
+  if (CPU -> fuseTable != NULL) {
+    CPU -> fuseTable[addr] = FUSE_UNKNOWN;
+    CPU -> fuseTable[(unsigned short) (addr - 1)] = FUSE_UNKNOWN;
+  }
+}
+
+// decide what the pair starting at pc fuses into
+static unsigned char classifyPair(MachineState* CPU, unsigned short pc) {
+  unsigned short first = CPU -> memory[pc];
+  unsigned short second = CPU -> memory[(unsigned short) (pc + 1)];
+  unsigned short op1 = INSN_OP(first);
+  unsigned short op2 = INSN_OP(second);
+
+  // CONST then HICONST of the same register, what the LC pseudo-op expands to
+  if (op1 == 9 && op2 == 13 && INSN_dest(first) == INSN_dest(second)) {
+    return FUSE_CONST_HICONST;
+  }
+  if (op1 == 2 && op2 == 0) {
+    return FUSE_CMP_BR;
+  }
+  // register or immediate ADD, [5:3] is 000 or 1xx
+  if (op1 == 6 && op2 == 1 && (INSN_ar_type(second) == 0 || INSN_5th_bit(second) == 1)) {
+    return FUSE_LDR_ADD;
+  }
+  return FUSE_NONE;
+}
+
+/*
+ * Run the pair at PC as a single step. The halves are the same helpers the
+ * unfused handlers use, so the machine ends up in the same state; only the
+ * dispatch and the intermediate PC update are skipped.
+ * Returns 0 if the pair can't be fused and the caller should run one
+ * instruction, 1 if the pair ran, and -1 if the pair faulted.
+ */
+static int runFused(MachineState* CPU)
+{
+  unsigned short pc = CPU -> PC;
+  unsigned char kind = CPU -> fuseTable[pc];
+  if (kind == FUSE_UNKNOWN) {
+    kind = classifyPair(CPU, pc);
+    CPU -> fuseTable[pc] = kind;
+  }
+  // the unfused path reports a bad second PC, and nothing runs the word at
+  // the halt address, so leave both cases to it
+  if (kind == FUSE_NONE || pc + 1 == 0x80FF || invalidPC(CPU, pc + 1)) {
+    return 0;
+  }
+
+  unsigned short first = CPU -> memory[pc];
+  unsigned short second = CPU -> memory[(unsigned short) (pc + 1)];
+  switch (kind) {
+    case FUSE_CONST_HICONST:
+      loadConst(CPU, first);
+      loadHiConst(CPU, second);
+      CPU -> PC = pc + 1;
+      setPC(CPU, CPU -> PC, NULL);
+      break;
+    case FUSE_CMP_BR:
+      compare(CPU, first);
+      CPU -> PC = pc + 1;
+      BranchOp(CPU, NULL);
+      break;
+    case FUSE_LDR_ADD:
+      if (loadWord(CPU, first) == -1) {
+        return raiseFault(CPU, FAULT_INVALID_ADDRESS, "Invalid memory address");
+      }
+      arithmetic(CPU, second);
+      CPU -> PC = pc + 1;
+      setPC(CPU, CPU -> PC, NULL);
+      break;
+  }
+  return 1;
+}
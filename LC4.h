@@ -2,10 +2,33 @@
  * LC4.h: Declares simulator functions for executing instructions
  */
 
+#ifndef LC4_H
+#define LC4_H
+
 #include "string.h"
 #include <stdio.h>
 #include <stdlib.h>
 
+// Why the machine stopped early, kept in MachineState.fault
+#define FAULT_NONE 0
+#define FAULT_INVALID_PC 1       // "Invalid PC, setting to default"
+#define FAULT_INVALID_ADDRESS 2  // "Invalid memory address"
+#define FAULT_INVALID_INSN 3     // "Invalid instruction"
+
+// Keyboard device registers, read through LDR in OS mode
+#define KBSR 0xFE00
+#define KBDR 0xFE02
+
+// Characters the keyboard device hands out, one per read of KBDR
+typedef struct Keyboard {
+    unsigned char* keys;
+    int length;
+    int next;
+
+    // set when KBSR is polled after every key was read
+    int drained;
+} Keyboard;
+
 typedef struct {
     // PC the current value of the Program Counter register
     unsigned short int PC;
@@ -33,23 +56,70 @@ typedef struct {
     unsigned short int dmemAddr;
     unsigned short int dmemValue;
 
+    // Optional cache models for instruction fetch and LDR/STR traffic, NULL when off
+    struct Cache* icache;
+    struct Cache* dcache;
+
+    // What each instruction pair fuses into when tracing is off, NULL when fusion is off
+    unsigned char* fuseTable;
+
+    // Optional ring of the most recent trace records, NULL when off
+    struct FlightRecorder* recorder;
+
+    // Optional keyboard behind KBSR/KBDR, NULL leaves those addresses as plain memory
+    struct Keyboard* keyboard;
+
+    // The last fault raised, one of the FAULT_ values
+    unsigned char fault;
+
     // Machine memory - all of it
     unsigned short int memory[65536];
 } MachineState;
 
+// Everything WriteOut prints for one cycle
+typedef struct {
+    unsigned short int PC;
+    unsigned short int insn;
+    unsigned char regFile_WE;
+    unsigned char rdMux_CTL;
+    unsigned char NZP_WE;
+    unsigned char DATA_WE;
+    unsigned short int regInputVal;
+    unsigned short int NZPVal;
+    unsigned short int dmemAddr;
+    unsigned short int dmemValue;
+    // FAULT_NONE, or the fault that ended the run on this cycle
+    unsigned char fault;
+} TraceRecord;
+
 
 /*
  * This function should execute one LC4 datapath cycle.
+ * Returns -1 on a fault, otherwise the number of instructions executed:
+ * 1, or 2 when a fused pair ran (see EnableFusion).
  */
 int UpdateMachineState(MachineState* CPU, FILE* output);
 
 
 /*
  * This function should write out the current state of the CPU to the file output.
+ * A NULL output writes nothing, which runs the machine with tracing off.
  */
 void WriteOut(MachineState* CPU, FILE* output);
 
 
+/*
+ * Copy the values WriteOut would print into record.
+ */
+void CaptureRecord(MachineState* CPU, TraceRecord* record);
+
+
+/*
+ * Write one captured record to output in the same format as WriteOut.
+ */
+void WriteRecord(TraceRecord* record, FILE* output);
+
+
 /*
  * This handles BRANCH instructions.
  */
@@ -107,4 +177,25 @@ void Reset(MachineState* CPU);
 /*
  * Clear all of the internal values (set to 0)
  */
-void ClearSignals(MachineState* CPU);
\ No newline at end of file
+void ClearSignals(MachineState* CPU);
+
+
+/*
+ * Start fusing common instruction pairs (CONST/HICONST, CMP/BR, LDR/ADD)
+ * into one step while tracing is off.
+ */
+int EnableFusion(MachineState* CPU);
+
+
+/*
+ * Stop fusing and release the fusion table.
+ */
+void DisableFusion(MachineState* CPU);
+
+
+/*
+ * Forget fused pairs that include addr. Call this after writing to memory directly.
+ */
+void InvalidateFusion(MachineState* CPU, unsigned short addr);
+
+#endif
@@ -0,0 +1,707 @@
+/*
+ * asm.c: Defines an assembler for LC4 assembly source files
+ *
+ * The assembler makes two passes over the source. The first pass assigns an
+ * address to every statement and records labels and .CONST/.UCONST values in
+ * a hash table; the second pass encodes each statement, looking up symbols by
+ * hash, into a 64K word image that remembers whether each word is code or
+ * data. The image is written out as the same CADE, DADA and C3B7 sections
+ * PennSim produces, so ReadObjectStream loads it like any other object file.
+ *
+ * Supported: every LC4 instruction, the RET, LEA and LC pseudo instructions,
+ * and the .CODE .DATA .OS .ADDR .FALIGN .FILL .BLKW .CONST .UCONST .END
+ * directives. Mnemonics, directives and registers are case insensitive,
+ * labels are not. A label may end with a colon or stand on a line by itself.
+ */
+
+#include "asm.h"
+#include "loader.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <strings.h>
+
+#define SYMBOL_BUCKETS 1024 // power of two
+#define LINE_LENGTH 1024
+#define MAX_TOKENS 8
+
+// what a word of the image holds
+#define WORD_NONE 0
+#define WORD_CODE 1
+#define WORD_DATA 2
+
+// operand layouts, see encode()
+#define F_NONE 0     // no operands
+#define F_BR 1       // label or IMM9 offset
+#define F_RRR 2      // Rd, Rs, Rt
+#define F_RRI 3      // Rd, Rs, Rt or Rd, Rs, IMM5
+#define F_RR 4       // Rd, Rs
+#define F_ST 5       // Rs, Rt
+#define F_SIMM7 6    // Rs, IMM7
+#define F_SUIMM7 7   // Rs, UIMM7
+#define F_JSR 8      // label on a 16 word boundary
+#define F_S 9        // Rs
+#define F_JMP 10     // label or IMM11 offset
+#define F_MEM 11     // Rd, Rs, IMM6
+#define F_CONST 12   // Rd, IMM9
+#define F_SHIFT 13   // Rd, Rs, UIMM4
+#define F_HICONST 14 // Rd, UIMM8
+#define F_TRAP 15    // UIMM8
+#define F_LEA 16     // Rd, label as CONST + HICONST
+#define F_LC 17      // Rd, constant as CONST, or CONST + HICONST if it doesn't fit
+
+typedef struct {
+  const char* name;
+  unsigned short bits;
+  int format;
+} Opcode;
+
+static const Opcode opcodes[] = {
+  { "NOP", 0x0000, F_NONE },
+  { "BR", 0x0E00, F_BR },
+  { "BRn", 0x0800, F_BR },
+  { "BRz", 0x0400, F_BR },
+  { "BRp", 0x0200, F_BR },
+  { "BRnz", 0x0C00, F_BR },
+  { "BRnp", 0x0A00, F_BR },
+  { "BRzp", 0x0600, F_BR },
+  { "BRnzp", 0x0E00, F_BR },
+  { "ADD", 0x1000, F_RRI },
+  { "MUL", 0x1008, F_RRR },
+  { "SUB", 0x1010, F_RRR },
+  { "DIV", 0x1018, F_RRR },
+  { "CMP", 0x2000, F_ST },
+  { "CMPU", 0x2080, F_ST },
+  { "CMPI", 0x2100, F_SIMM7 },
+  { "CMPIU", 0x2180, F_SUIMM7 },
+  { "JSRR", 0x4000, F_S },
+  { "JSR", 0x4800, F_JSR },
+  { "AND", 0x5000, F_RRI },
+  { "NOT", 0x5008, F_RR },
+  { "OR", 0x5010, F_RRR },
+  { "XOR", 0x5018, F_RRR },
+  { "LDR", 0x6000, F_MEM },
+  { "STR", 0x7000, F_MEM },
+  { "RTI", 0x8000, F_NONE },
+  { "CONST", 0x9000, F_CONST },
+  { "SLL", 0xA000, F_SHIFT },
+  { "SRA", 0xA010, F_SHIFT },
+  { "SRL", 0xA020, F_SHIFT },
+  { "MOD", 0xA030, F_RRR },
+  { "JMPR", 0xC000, F_S },
+  { "JMP", 0xC800, F_JMP },
+  { "RET", 0xC1C0, F_NONE },
+  { "HICONST", 0xD100, F_HICONST },
+  { "TRAP", 0xF000, F_TRAP },
+  { "LEA", 0x9000, F_LEA },
+  { "LC", 0x9000, F_LC },
+};
+
+static const char* directives[] = {
+  ".CODE", ".DATA", ".OS", ".ADDR", ".FALIGN", ".FILL", ".BLKW", ".CONST", ".UCONST", ".END",
+};
+
+typedef struct Symbol {
+  char* name;
+  int value;
+  int isLabel;
+  int line; // where it was defined
+  struct Symbol* next; // next in the same bucket
+  struct Symbol* nextDefined; // next in definition order
+} Symbol;
+
+typedef struct {
+  char* source;
+  int pass;
+  int line;
+  int errors;
+
+  Symbol* buckets[SYMBOL_BUCKETS];
+  Symbol* firstDefined;
+  Symbol* lastDefined;
+
+  // next address of each section, indexed by [os][data]
+  unsigned int address[2][2];
+  int os;
+  int data;
+
+  unsigned short words[65536];
+  unsigned char kinds[65536];
+} Assembler;
+
+//helpers:
+static void error(Assembler* as, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  printf("%s:%d: ", as -> source, as -> line);
+  vprintf(format, args);
+  printf("\n");
+  va_end(args);
+  as -> errors++;
+}
+
+// FNV-1a
+static unsigned int hashName(const char* name) {
+  unsigned int hash = 2166136261u;
+  for (; *name != '\0'; name++) {
+    hash = (hash ^ (unsigned char) *name) * 16777619u;
+  }
+  return hash & (SYMBOL_BUCKETS - 1);
+}
+
+static Symbol* findSymbol(Assembler* as, const char* name) {
+  for (Symbol* symbol = as -> buckets[hashName(name)]; symbol != NULL; symbol = symbol -> next) {
+    if (strcmp(symbol -> name, name) == 0) {
+      return symbol;
+    }
+  }
+  return NULL;
+}
+
+// symbols are only defined in the first pass; the second pass sees the same table
+static void defineSymbol(Assembler* as, char* name, int value, int isLabel) {
+  if (as -> pass != 1) {
+    return;
+  }
+  if (!(isalpha((unsigned char) name[0]) || name[0] == '_')) {
+    error(as, "invalid label %s", name);
+    return;
+  }
+  if (findSymbol(as, name) != NULL) {
+    error(as, "%s is defined twice", name);
+    return;
+  }
+  Symbol* symbol = calloc(1, sizeof(Symbol));
+  if (symbol == NULL || (symbol -> name = strdup(name)) == NULL) {
+    free(symbol);
+    error(as, "out of memory");
+    return;
+  }
+  symbol -> value = value;
+  symbol -> isLabel = isLabel;
+  symbol -> line = as -> line;
+  unsigned int bucket = hashName(name);
+  symbol -> next = as -> buckets[bucket];
+  as -> buckets[bucket] = symbol;
+  if (as -> lastDefined == NULL) {
+    as -> firstDefined = symbol;
+  } else {
+    as -> lastDefined -> nextDefined = symbol;
+  }
+  as -> lastDefined = symbol;
+}
+
+static void freeSymbols(Assembler* as) {
+  Symbol* symbol = as -> firstDefined;
+  while (symbol != NULL) {
+    Symbol* next = symbol -> nextDefined;
+    free(symbol -> name);
+    free(symbol);
+    symbol = next;
+  }
+}
+
+static const Opcode* findOpcode(const char* name) {
+  for (size_t i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++) {
+    if (strcasecmp(opcodes[i].name, name) == 0) {
+      return &opcodes[i];
+    }
+  }
+  return NULL;
+}
+
+static int isDirective(const char* name) {
+  for (size_t i = 0; i < sizeof(directives) / sizeof(directives[0]); i++) {
+    if (strcasecmp(directives[i], name) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// #12, #-12, 12, x1F, 0x1F, -x1F; returns -1 if token is not a number
+static int parseNumber(const char* token, int* value) {
+  int negative = 0;
+  int base = 10;
+  if (*token == '#') {
+    token++;
+  }
+  if (*token == '-') {
+    negative = 1;
+    token++;
+  }
+  if (token[0] == '0' && (token[1] == 'x' || token[1] == 'X')) {
+    base = 16;
+    token += 2;
+  } else if (*token == 'x' || *token == 'X') {
+    base = 16;
+    token++;
+  }
+  if (*token == '\0') {
+    return -1;
+  }
+  long result = 0;
+  for (; *token != '\0'; token++) {
+    int digit;
+    if (isdigit((unsigned char) *token)) {
+      digit = *token - '0';
+    } else if (base == 16 && isxdigit((unsigned char) *token)) {
+      digit = tolower((unsigned char) *token) - 'a' + 10;
+    } else {
+      return -1;
+    }
+    result = result * base + digit;
+    if (result > 0xFFFF) {
+      return -1;
+    }
+  }
+  *value = negative ? -result : result;
+  return 0;
+}
+
+static int parseRegister(Assembler* as, const char* token) {
+  if ((token[0] == 'R' || token[0] == 'r') && token[1] >= '0' && token[1] <= '7' && token[2] == '\0') {
+    return token[1] - '0';
+  }
+  error(as, "expected a register, got %s", token);
+  return 0;
+}
+
+static int isRegister(const char* token) {
+  return (token[0] == 'R' || token[0] == 'r') && token[1] >= '0' && token[1] <= '7' && token[2] == '\0';
+}
+
+// the value of a number or symbol; undefined symbols are 0 until the second pass
+static int resolve(Assembler* as, const char* token, int* value) {
+  if (parseNumber(token, value) == 0) {
+    return 0;
+  }
+  Symbol* symbol = findSymbol(as, token);
+  if (symbol == NULL) {
+    *value = 0;
+    if (as -> pass == 2) {
+      error(as, "undefined symbol %s", token);
+      return -1;
+    }
+    return 0;
+  }
+  *value = symbol -> value;
+  return 0;
+}
+
+// a value the first pass needs, e.g. for .ADDR, so it has to be known already
+static int resolveNow(Assembler* as, const char* token, int* value) {
+  Symbol* symbol = findSymbol(as, token);
+  if (parseNumber(token, value) == 0) {
+    return 0;
+  }
+  if (symbol == NULL || symbol -> line >= as -> line) {
+    error(as, "%s must be a number or a constant defined above", token);
+    return -1;
+  }
+  *value = symbol -> value;
+  return 0;
+}
+
+// check value fits in a bits wide field and return it masked to the field
+static unsigned short field(Assembler* as, int value, int bits, int isSigned) {
+  int low = isSigned ? -(1 << (bits - 1)) : 0;
+  int high = isSigned ? (1 << (bits - 1)) - 1 : (1 << bits) - 1;
+  if (as -> pass == 2 && (value < low || value > high)) {
+    error(as, "%d does not fit in %s IMM%d", value, isSigned ? "signed" : "unsigned", bits);
+  }
+  return value & ((1 << bits) - 1);
+}
+
+// a label or immediate offset relative to the next instruction
+static unsigned short offset(Assembler* as, const char* token, int bits) {
+  int value;
+  if (parseNumber(token, &value) == 0) {
+    return field(as, value, bits, 1);
+  }
+  resolve(as, token, &value);
+  int pc = as -> address[as -> os][as -> data];
+  return field(as, value - (pc + 1), bits, 1);
+}
+
+// LC uses a single CONST when its value is known in the first pass and fits
+static int isWideConstant(Assembler* as, const char* token) {
+  int value;
+  if (parseNumber(token, &value) != 0) {
+    Symbol* symbol = findSymbol(as, token);
+    if (symbol == NULL || symbol -> isLabel || symbol -> line >= as -> line) {
+      return 1;
+    }
+    value = symbol -> value;
+  }
+  short word = value & 0xFFFF;
+  return word < -256 || word > 255;
+}
+
+static void emit(Assembler* as, unsigned short word) {
+  unsigned int* address = &as -> address[as -> os][as -> data];
+  if (*address > 0xFFFF) {
+    if (*address == 0x10000) {
+      error(as, "ran past the end of memory");
+    }
+    (*address)++;
+    return;
+  }
+  if (as -> pass == 2) {
+    if (as -> kinds[*address] != WORD_NONE) {
+      error(as, "address x%04X is assigned twice", *address);
+    }
+    as -> words[*address] = word;
+    as -> kinds[*address] = as -> data ? WORD_DATA : WORD_CODE;
+  }
+  (*address)++;
+}
+
+static int expect(Assembler* as, const char* name, int count, int expected) {
+  if (count != expected) {
+    error(as, "%s takes %d operand%s", name, expected, expected == 1 ? "" : "s");
+    return -1;
+  }
+  return 0;
+}
+
+// encode one instruction with its operands
+static void encode(Assembler* as, const Opcode* op, char** args, int count) {
+  static const int operands[] = { 0, 1, 3, 3, 2, 2, 2, 2, 1, 1, 1, 3, 2, 3, 2, 1, 2, 2 };
+  if (expect(as, op -> name, count, operands[op -> format]) == -1) {
+    return;
+  }
+
+  unsigned short insn = op -> bits;
+  int value = 0;
+  switch (op -> format) {
+    case F_NONE:
+      break;
+    case F_BR:
+      insn |= offset(as, args[0], 9);
+      break;
+    case F_RRR:
+      insn |= parseRegister(as, args[0]) << 9 | parseRegister(as, args[1]) << 6 | parseRegister(as, args[2]);
+      break;
+    case F_RRI:
+      insn |= parseRegister(as, args[0]) << 9 | parseRegister(as, args[1]) << 6;
+      if (isRegister(args[2])) {
+        insn |= parseRegister(as, args[2]);
+      } else {
+        resolve(as, args[2], &value);
+        insn |= 0x20 | field(as, value, 5, 1);
+      }
+      break;
+    case F_RR:
+      insn |= parseRegister(as, args[0]) << 9 | parseRegister(as, args[1]) << 6;
+      break;
+    case F_ST:
+      insn |= parseRegister(as, args[0]) << 9 | parseRegister(as, args[1]);
+      break;
+    case F_SIMM7:
+    case F_SUIMM7:
+      resolve(as, args[1], &value);
+      insn |= parseRegister(as, args[0]) << 9 | field(as, value, 7, op -> format == F_SIMM7);
+      break;
+    case F_JSR:
+      resolve(as, args[0], &value);
+      if (as -> pass == 2 && (value & 0xF) != 0) {
+        error(as, "JSR target x%04X is not on a 16 word boundary, use .FALIGN", value & 0xFFFF);
+      }
+      // the target keeps bit 15 of the JSR's own address
+      if (as -> pass == 2 && (value & 0x8000) != (as -> address[as -> os][as -> data] & 0x8000)) {
+        error(as, "JSR target x%04X is in the other half of memory, use JSRR", value & 0xFFFF);
+      }
+      insn |= (value >> 4) & 0x7FF;
+      break;
+    case F_S:
+      insn |= parseRegister(as, args[0]) << 6;
+      break;
+    case F_JMP:
+      insn |= offset(as, args[0], 11);
+      break;
+    case F_MEM:
+      resolve(as, args[2], &value);
+      insn |= parseRegister(as, args[0]) << 9 | parseRegister(as, args[1]) << 6 | field(as, value, 6, 1);
+      break;
+    case F_CONST:
+      resolve(as, args[1], &value);
+      insn |= parseRegister(as, args[0]) << 9 | field(as, value, 9, 1);
+      break;
+    case F_SHIFT:
+      resolve(as, args[2], &value);
+      insn |= parseRegister(as, args[0]) << 9 | parseRegister(as, args[1]) << 6 | field(as, value, 4, 0);
+      break;
+    case F_HICONST:
+      resolve(as, args[1], &value);
+      insn |= parseRegister(as, args[0]) << 9 | field(as, value, 8, 0);
+      break;
+    case F_TRAP:
+      resolve(as, args[0], &value);
+      insn |= field(as, value, 8, 0);
+      break;
+    case F_LEA:
+    case F_LC: {
+      int d = parseRegister(as, args[0]);
+      int wide = op -> format == F_LEA || isWideConstant(as, args[1]);
+      resolve(as, args[1], &value);
+      if (!wide) {
+        emit(as, 0x9000 | d << 9 | (value & 0x1FF));
+        return;
+      }
+      // CONST sets the low byte, HICONST replaces the high byte
+      emit(as, 0x9000 | d << 9 | (value & 0xFF));
+      insn = 0xD100 | d << 9 | ((value >> 8) & 0xFF);
+      break;
+    }
+  }
+  emit(as, insn);
+}
+
+// returns 1 at .END
+static int directive(Assembler* as, char* name, char* label, char** args, int count) {
+  int value = 0;
+  unsigned int* address = &as -> address[as -> os][as -> data];
+
+  if (strcasecmp(name, ".CONST") == 0 || strcasecmp(name, ".UCONST") == 0) {
+    if (label == NULL) {
+      error(as, "%s needs a label", name);
+    } else if (expect(as, name, count, 1) == 0 && resolveNow(as, args[0], &value) == 0) {
+      int isSigned = strcasecmp(name, ".CONST") == 0;
+      if (isSigned ? (value < -32768 || value > 32767) : (value < 0 || value > 0xFFFF)) {
+        error(as, "%d is out of range for %s", value, name);
+      }
+      defineSymbol(as, label, value, 0);
+    }
+    return 0;
+  }
+
+  if (strcasecmp(name, ".CODE") == 0) {
+    as -> data = 0;
+  } else if (strcasecmp(name, ".DATA") == 0) {
+    as -> data = 1;
+  } else if (strcasecmp(name, ".OS") == 0) {
+    as -> os = 1;
+  } else if (strcasecmp(name, ".ADDR") == 0) {
+    if (expect(as, name, count, 1) == 0 && resolveNow(as, args[0], &value) == 0) {
+      *address = value & 0xFFFF;
+    }
+  } else if (strcasecmp(name, ".FALIGN") == 0) {
+    *address = (*address + 15) & ~15u;
+  } else if (strcasecmp(name, ".END") == 0) {
+    return 1;
+  }
+
+  // anything else labels the address it starts at
+  address = &as -> address[as -> os][as -> data];
+  if (label != NULL) {
+    defineSymbol(as, label, *address & 0xFFFF, 1);
+  }
+
+  if (strcasecmp(name, ".FILL") == 0) {
+    if (expect(as, name, count, 1) == 0) {
+      resolve(as, args[0], &value);
+      if (value < -32768 || value > 0xFFFF) {
+        error(as, "%d does not fit in a word", value);
+      }
+      emit(as, value & 0xFFFF);
+    }
+  } else if (strcasecmp(name, ".BLKW") == 0) {
+    if (expect(as, name, count, 1) == 0 && resolveNow(as, args[0], &value) == 0) {
+      if (value < 0 || value > 0xFFFF) {
+        error(as, "invalid .BLKW size %d", value);
+        value = 0;
+      }
+      for (int i = 0; i < value; i++) {
+        emit(as, 0);
+      }
+    }
+  }
+  return 0;
+}
+
+// assemble one line; returns 1 at .END
+static int assembleLine(Assembler* as, char* text) {
+  char* tokens[MAX_TOKENS];
+  int count = 0;
+
+  text[strcspn(text, ";")] = '\0';
+  for (char* c = text; *c != '\0'; c++) {
+    if (*c == ',') {
+      *c = ' ';
+    }
+  }
+  for (char* token = strtok(text, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n")) {
+    if (count == MAX_TOKENS) {
+      error(as, "too many operands");
+      return 0;
+    }
+    tokens[count++] = token;
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  // a leading word that is not an instruction or directive is a label
+  char* label = NULL;
+  int first = 0;
+  if (findOpcode(tokens[0]) == NULL && !isDirective(tokens[0])) {
+    label = tokens[0];
+    size_t length = strlen(label);
+    if (length > 1 && label[length - 1] == ':') {
+      label[length - 1] = '\0';
+    }
+    first = 1;
+  }
+
+  if (first == count) {
+    defineSymbol(as, label, as -> address[as -> os][as -> data] & 0xFFFF, 1);
+    return 0;
+  }
+
+  char* name = tokens[first];
+  char** args = tokens + first + 1;
+  int argCount = count - first - 1;
+  if (isDirective(name)) {
+    return directive(as, name, label, args, argCount);
+  }
+
+  const Opcode* op = findOpcode(name);
+  if (op == NULL) {
+    error(as, "unknown instruction %s", name);
+    return 0;
+  }
+  if (label != NULL) {
+    defineSymbol(as, label, as -> address[as -> os][as -> data] & 0xFFFF, 1);
+  }
+  encode(as, op, args, argCount);
+  return 0;
+}
+
+static void runPass(Assembler* as, FILE* file, int pass) {
+  char text[LINE_LENGTH];
+  as -> pass = pass;
+  as -> line = 0;
+  as -> os = 0;
+  as -> data = 0;
+  // user code, user data, OS code and OS data start where PennSim puts them
+  as -> address[0][0] = 0x0000;
+  as -> address[0][1] = 0x2000;
+  as -> address[1][0] = 0x8000;
+  as -> address[1][1] = 0xA000;
+
+  rewind(file);
+  while (fgets(text, sizeof(text), file) != NULL) {
+    as -> line++;
+    if (strchr(text, '\n') == NULL && !feof(file)) {
+      error(as, "line is longer than %d characters", LINE_LENGTH - 2);
+      int c;
+      while ((c = fgetc(file)) != EOF && c != '\n') {
+      }
+      continue;
+    }
+    if (assembleLine(as, text) == 1) {
+      break;
+    }
+  }
+}
+
+static void putWord(FILE* object, unsigned short word) {
+  fputc(word >> 8, object);
+  fputc(word & 0xFF, object);
+}
+
+// one section per run of consecutive words of kind
+static void writeSections(Assembler* as, FILE* object, unsigned char kind, unsigned short header) {
+  unsigned int address = 0;
+  while (address < 65536) {
+    if (as -> kinds[address] != kind) {
+      address++;
+      continue;
+    }
+    unsigned int end = address;
+    while (end < 65536 && as -> kinds[end] == kind && end - address < 0xFFFF) {
+      end++;
+    }
+    putWord(object, header);
+    putWord(object, address);
+    putWord(object, end - address);
+    for (; address < end; address++) {
+      putWord(object, as -> words[address]);
+    }
+  }
+}
+
+/*
+ * Assemble source and write it to object as CADE sections for code, DADA
+ * sections for data and one C3B7 section per label.
+ */
+int AssembleFile(char* source, FILE* object)
+{
+  FILE* file = fopen(source, "r");
+  if (file == NULL) {
+    printf("could not open %s\n", source);
+    return -1;
+  }
+  Assembler* as = calloc(1, sizeof(Assembler));
+  if (as == NULL) {
+    printf("could not allocate assembler\n");
+    fclose(file);
+    return -1;
+  }
+  as -> source = source;
+
+  runPass(as, file, 1);
+  if (as -> errors == 0) {
+    runPass(as, file, 2);
+  }
+  fclose(file);
+
+  int result = -1;
+  if (as -> errors == 0) {
+    writeSections(as, object, WORD_CODE, 0xCADE);
+    writeSections(as, object, WORD_DATA, 0xDADA);
+    for (Symbol* symbol = as -> firstDefined; symbol != NULL; symbol = symbol -> nextDefined) {
+      if (symbol -> isLabel) {
+        size_t length = strlen(symbol -> name);
+        putWord(object, 0xC3B7);
+        putWord(object, symbol -> value);
+        putWord(object, length);
+        fwrite(symbol -> name, 1, length, object);
+      }
+    }
+    result = ferror(object) ? -1 : 0;
+  } else {
+    printf("%s: %d error%s\n", source, as -> errors, as -> errors == 1 ? "" : "s");
+  }
+
+  freeSymbols(as);
+  free(as);
+  return result;
+}
+
+/*
+ * Assemble source into an object image held in memory and load that image,
+ * so symbols reach the loader's SymbolHandler just like a file from disk.
+ */
+int AssembleIntoMachine(char* source, MachineState* CPU)
+{
+  char* image = NULL;
+  size_t size = 0;
+  FILE* object = open_memstream(&image, &size);
+  if (object == NULL) {
+    printf("could not allocate object image\n");
+    return -1;
+  }
+  int result = AssembleFile(source, object);
+  fclose(object);
+
+  if (result == 0 && size > 0) {
+    FILE* stream = fmemopen(image, size, "rb");
+    result = (stream == NULL) ? -1 : ReadObjectStream(stream, CPU);
+    if (stream != NULL) {
+      fclose(stream);
+    }
+  }
+  free(image);
+  return result;
+}
@@ -0,0 +1,19 @@
+/*
+ * asm.h: Declares an assembler for LC4 assembly source files
+ */
+
+#ifndef ASM_H
+#define ASM_H
+
+#include <stdio.h>
+#include "LC4.h"
+
+// Assemble source and write the result as an object file (CADE/DADA/C3B7 sections)
+// to object. Returns -1 if the source has errors, which are printed with line numbers.
+int AssembleFile(char* source, FILE* object);
+
+// Assemble source and load it into CPU's memory without going through the disk,
+// exactly as ReadObjectFile would load the object file. Returns -1 on errors.
+int AssembleIntoMachine(char* source, MachineState* CPU);
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * cache.c: Defines a configurable set-associative cache model
+ *
+ * The model only tracks tags, so it runs alongside the simulator without
+ * changing what the guest program sees. Memory use is fixed by the cache
+ * geometry and the per-PC counters, not by the length of the run.
+ */
+
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define REPORT_ENTRIES 10
+
+//helpers:
+// log2 of n, or -1 if n is not a power of two
+static int log2Exact(int n) {
+  int bits = 0;
+  if (n <= 0 || (n & (n - 1)) != 0) {
+    return -1;
+  }
+  while ((1 << bits) < n) {
+    bits++;
+  }
+  return bits;
+}
+
+/*
+ * Set up a cache from its config string.
+ */
+int CacheInit(Cache* cache, const char* name, char* config)
+{
+  char settings[128];
+  memset(cache, 0, sizeof(Cache));
+  cache -> name = name;
+  cache -> size = 1024;
+  cache -> assoc = 1;
+  cache -> block = 4;
+  cache -> writePolicy = WRITE_BACK;
+  cache -> replacement = REPLACE_LRU;
+  cache -> seed = 0x2400;
+
+  strncpy(settings, config, sizeof(settings) - 1);
+  settings[sizeof(settings) - 1] = '\0';
+  for (char* item = strtok(settings, ","); item != NULL; item = strtok(NULL, ",")) {
+    char* value = strchr(item, '=');
+    if (value == NULL) {
+      printf("invalid %s setting: %s\n", name, item);
+      return -1;
+    }
+    *value++ = '\0';
+    if (strcmp(item, "size") == 0) {
+      cache -> size = atoi(value);
+    } else if (strcmp(item, "assoc") == 0) {
+      cache -> assoc = atoi(value);
+    } else if (strcmp(item, "block") == 0) {
+      cache -> block = atoi(value);
+    } else if (strcmp(item, "write") == 0 && strcmp(value, "wb") == 0) {
+      cache -> writePolicy = WRITE_BACK;
+    } else if (strcmp(item, "write") == 0 && strcmp(value, "wt") == 0) {
+      cache -> writePolicy = WRITE_THROUGH;
+    } else if (strcmp(item, "repl") == 0 && strcmp(value, "lru") == 0) {
+      cache -> replacement = REPLACE_LRU;
+    } else if (strcmp(item, "repl") == 0 && strcmp(value, "random") == 0) {
+      cache -> replacement = REPLACE_RANDOM;
+    } else {
+      printf("invalid %s setting: %s=%s\n", name, item, value);
+      return -1;
+    }
+  }
+
+  cache -> blockBits = log2Exact(cache -> block);
+  if (cache -> blockBits < 0 || log2Exact(cache -> assoc) < 0 || log2Exact(cache -> size) < 0 ||
+  cache -> size > 65536 || cache -> size < (long long) cache -> block * cache -> assoc) {
+    printf("invalid %s geometry: sizes must be powers of 2 and size >= block * assoc\n", name);
+    return -1;
+  }
+  cache -> sets = cache -> size / (cache -> block * cache -> assoc);
+
+  cache -> lines = calloc(cache -> sets * cache -> assoc, sizeof(CacheLine));
+  cache -> pcAccesses = calloc(65536, sizeof(unsigned int));
+  cache -> pcMisses = calloc(65536, sizeof(unsigned int));
+  cache -> setMisses = calloc(cache -> sets, sizeof(unsigned int));
+  cache -> setEvictions = calloc(cache -> sets, sizeof(unsigned int));
+  if (cache -> lines == NULL || cache -> pcAccesses == NULL || cache -> pcMisses == NULL ||
+  cache -> setMisses == NULL || cache -> setEvictions == NULL) {
+    printf("could not allocate %s\n", name);
+    CacheFree(cache);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Model one access to addr made by the instruction at pc.
+ */
+int CacheAccess(Cache* cache, unsigned short pc, unsigned short addr, int isWrite)
+{
+  unsigned int blockAddr = addr >> cache -> blockBits;
+  unsigned int set = blockAddr & (cache -> sets - 1);
+  unsigned short tag = blockAddr / cache -> sets;
+  CacheLine* ways = &cache -> lines[set * cache -> assoc];
+  CacheLine* victim = &ways[0];
+
+  cache -> clock++;
+  cache -> pcAccesses[pc]++;
+  if (isWrite) {
+    cache -> writes++;
+  } else {
+    cache -> reads++;
+  }
+
+  for (int i = 0; i < cache -> assoc; i++) {
+    if (ways[i].valid && ways[i].tag == tag) {
+      ways[i].lastUse = cache -> clock;
+      if (isWrite && cache -> writePolicy == WRITE_BACK) {
+        ways[i].dirty = 1;
+      } else if (isWrite) {
+        cache -> memoryWrites++;
+      }
+      return 1;
+    }
+  }
+
+  // miss
+  cache -> pcMisses[pc]++;
+  cache -> setMisses[set]++;
+  if (isWrite) {
+    cache -> writeMisses++;
+    if (cache -> writePolicy == WRITE_THROUGH) {
+      cache -> memoryWrites++;
+      return 0;
+    }
+  } else {
+    cache -> readMisses++;
+  }
+
+  // pick an invalid way first, then fall back to the replacement policy
+  int found = 0;
+  for (int i = 0; i < cache -> assoc && !found; i++) {
+    if (!ways[i].valid) {
+      victim = &ways[i];
+      found = 1;
+    }
+  }
+  if (!found && cache -> replacement == REPLACE_LRU) {
+    for (int i = 1; i < cache -> assoc; i++) {
+      if (ways[i].lastUse < victim -> lastUse) {
+        victim = &ways[i];
+      }
+    }
+  } else if (!found) {
+    // xorshift keeps random replacement reproducible between runs
+    cache -> seed ^= cache -> seed << 13;
+    cache -> seed ^= cache -> seed >> 17;
+    cache -> seed ^= cache -> seed << 5;
+    victim = &ways[cache -> seed % cache -> assoc];
+  }
+
+  if (victim -> valid) {
+    cache -> setEvictions[set]++;
+    if (victim -> dirty) {
+      cache -> writebacks++;
+    }
+  }
+  victim -> valid = 1;
+  victim -> dirty = isWrite;
+  victim -> tag = tag;
+  victim -> lastUse = cache -> clock;
+  return 0;
+}
+
+// index of the largest entry of counts that ranks after (last, lastIndex), or -1
+static int nextLargest(unsigned int* counts, int n, unsigned int last, int lastIndex) {
+  unsigned int best = 0;
+  int bestIndex = -1;
+  for (int i = 0; i < n; i++) {
+    if (counts[i] == 0 || counts[i] > last || (counts[i] == last && i <= lastIndex)) {
+      continue;
+    }
+    if (counts[i] > best) {
+      best = counts[i];
+      bestIndex = i;
+    }
+  }
+  return bestIndex;
+}
+
+/*
+ * Write hit/miss rates, the PCs with the most misses and the most conflicted sets.
+ */
+void CacheReport(Cache* cache, FILE* output)
+{
+  unsigned long long accesses = cache -> reads + cache -> writes;
+  unsigned long long misses = cache -> readMisses + cache -> writeMisses;
+  double total = accesses ? (double) accesses : 1.0;
+
+  fprintf(output, "%s: %d words, %d-way, %d-word blocks, %d sets, %s, %s\n", cache -> name,
+    cache -> size, cache -> assoc, cache -> block, cache -> sets,
+    cache -> writePolicy == WRITE_BACK ? "write-back" : "write-through",
+    cache -> replacement == REPLACE_LRU ? "LRU" : "random");
+  fprintf(output, "  accesses      %llu (%llu reads, %llu writes)\n", accesses, cache -> reads, cache -> writes);
+  fprintf(output, "  hits          %llu (%.2f%%)\n", accesses - misses, 100.0 * (accesses - misses) / total);
+  fprintf(output, "  misses        %llu (%.2f%%, %llu reads, %llu writes)\n", misses, 100.0 * misses / total,
+    cache -> readMisses, cache -> writeMisses);
+  if (cache -> writes) {
+    fprintf(output, "  writebacks    %llu\n", cache -> writebacks);
+    fprintf(output, "  memory writes %llu\n", cache -> memoryWrites);
+  }
+
+  fprintf(output, "  top missing PCs:\n");
+  fprintf(output, "    PC    accesses   misses     miss rate\n");
+  int index = -1;
+  unsigned int last = 0xFFFFFFFF;
+  for (int shown = 0; shown < REPORT_ENTRIES; shown++) {
+    index = nextLargest(cache -> pcMisses, 65536, last, index);
+    if (index < 0) {
+      break;
+    }
+    last = cache -> pcMisses[index];
+    fprintf(output, "    %04X  %-10u %-10u %.2f%%\n", index, cache -> pcAccesses[index], last,
+      100.0 * last / cache -> pcAccesses[index]);
+  }
+
+  fprintf(output, "  top conflicting sets:\n");
+  fprintf(output, "    set   evictions  misses     addresses\n");
+  index = -1;
+  last = 0xFFFFFFFF;
+  for (int shown = 0; shown < REPORT_ENTRIES; shown++) {
+    index = nextLargest(cache -> setEvictions, cache -> sets, last, index);
+    if (index < 0) {
+      break;
+    }
+    last = cache -> setEvictions[index];
+    fprintf(output, "    %-5d %-10u %-10u %04X + k * %04X\n", index, last, cache -> setMisses[index],
+      index << cache -> blockBits, (cache -> sets << cache -> blockBits) & 0xFFFF);
+  }
+}
+
+/*
+ * Release the lines and counters of the cache.
+ */
+void CacheFree(Cache* cache)
+{
+  free(cache -> lines);
+  free(cache -> pcAccesses);
+  free(cache -> pcMisses);
+  free(cache -> setMisses);
+  free(cache -> setEvictions);
+  cache -> lines = NULL;
+  cache -> pcAccesses = NULL;
+  cache -> pcMisses = NULL;
+  cache -> setMisses = NULL;
+  cache -> setEvictions = NULL;
+}
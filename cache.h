@@ -0,0 +1,86 @@
+/*
+ * cache.h: Declares a configurable cache model for LC4 memory traffic
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+
+// Write policies
+#define WRITE_BACK 0     // write-back, write-allocate
+#define WRITE_THROUGH 1  // write-through, no-write-allocate
+
+// Replacement policies
+#define REPLACE_LRU 0
+#define REPLACE_RANDOM 1
+
+typedef struct {
+    unsigned short tag;
+    unsigned char valid;
+    unsigned char dirty;
+    unsigned long long lastUse;
+} CacheLine;
+
+typedef struct Cache {
+    // the name printed in the report, e.g. "icache"
+    const char* name;
+
+    // geometry, all sizes are in 16-bit words
+    int size;
+    int assoc;
+    int block;
+    int sets;
+    int blockBits;
+    int writePolicy;
+    int replacement;
+
+    // sets * assoc lines, set i occupies lines[i * assoc .. i * assoc + assoc - 1]
+    CacheLine* lines;
+    unsigned long long clock;
+    unsigned int seed;
+
+    // totals across the whole run
+    unsigned long long reads;
+    unsigned long long writes;
+    unsigned long long readMisses;
+    unsigned long long writeMisses;
+    unsigned long long writebacks;
+    unsigned long long memoryWrites;
+
+    // misses per PC and per set, and valid lines evicted per set
+    unsigned int* pcAccesses;
+    unsigned int* pcMisses;
+    unsigned int* setMisses;
+    unsigned int* setEvictions;
+} Cache;
+
+
+/*
+ * Set up a cache from a config string of comma separated key=value pairs:
+ * size=<words>, assoc=<ways>, block=<words>, write=wb|wt, repl=lru|random.
+ * Returns -1 if the config is invalid.
+ */
+int CacheInit(Cache* cache, const char* name, char* config);
+
+
+/*
+ * Model one access to addr made by the instruction at pc.
+ * Returns 1 on a hit and 0 on a miss.
+ */
+int CacheAccess(Cache* cache, unsigned short pc, unsigned short addr, int isWrite);
+
+
+/*
+ * Write hit/miss rates, the PCs with the most misses and the most
+ * conflicted sets to output.
+ */
+void CacheReport(Cache* cache, FILE* output);
+
+
+/*
+ * Release the lines and counters of the cache.
+ */
+void CacheFree(Cache* cache);
+
+#endif
@@ -0,0 +1,632 @@
+/*
+ * fuzz.c: location of main() for the coverage-guided fuzzer
+ *
+ * fuzz loads the object files once and keeps that machine as a snapshot.
+ * Every execution restores the snapshot in process, writes the input into
+ * the chosen memory regions and the keyboard, and runs until the machine
+ * halts, faults, polls an empty keyboard or reaches the cycle limit. Only
+ * the registers and the 256-word pages the last run wrote are copied back,
+ * so a reset costs far less than a full MachineState copy.
+ *
+ * Each control transfer (BR, JSR/JSRR, JMP/JMPR, TRAP, RTI) is an edge from
+ * its PC to the PC it left the machine at. Workers, one per core, share the
+ * edge bitmap through an anonymous shared mapping. An input is kept when it
+ * reaches an edge no worker has seen (queue/), however the run ended. It is
+ * also saved when it faults through "Invalid PC", "Invalid memory address",
+ * an invalid instruction or a crash of the simulator itself (faults/), or
+ * when it hits the cycle limit (hangs/). Faults and hangs are saved once
+ * per PC they happened at.
+ *
+ * An input file holds the words of every -m region, big endian and in the
+ * order the regions were given, followed by the keyboard characters.
+ */
+
+#include "loader.h"
+#include "asm.h"
+#include <errno.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FUZZ_MAP_SIZE 65536 // power of two
+#define MAX_REGIONS 16
+#define MAX_WORKERS 256
+#define PAGE_WORDS 256
+#define DEFAULT_LIMIT 10000
+#define DEFAULT_KEYS 0
+#define MUTATIONS_PER_PICK 64
+#define RESTORE_CHECK_INTERVAL 256
+
+// How a run ended
+#define RUN_HALTED 0
+#define RUN_DRAINED 1 // polled the keyboard after the last key
+#define RUN_LIMIT 2
+#define RUN_FAULT 3
+#define RUN_CRASH 4   // the simulator raised a signal, e.g. SIGFPE from DIV
+
+static const char* outcomeNames[] = { "halted", "drained", "limit", "fault", "crash" };
+
+// State every worker shares
+typedef struct {
+    // edges any worker has reached
+    unsigned char edges[FUZZ_MAP_SIZE];
+
+    // fault and hang sites that already have a saved input
+    unsigned char outcomes[FUZZ_MAP_SIZE];
+
+    unsigned long long execs;
+    unsigned long long edgeCount;
+    unsigned long long queued;
+    unsigned long long faults;
+    unsigned long long hangs;
+    volatile int stop;
+} Shared;
+
+typedef struct {
+    unsigned short address;
+    unsigned short words;
+} Region;
+
+typedef struct {
+    unsigned char* bytes;
+    int length;
+} Input;
+
+// the machine right after loading, and the one each run mutates
+MachineState snapshot;
+MachineState machine;
+Keyboard keyboard;
+
+Region regions[MAX_REGIONS];
+int regionCount;
+int regionBytes;
+int maxKeys = DEFAULT_KEYS;
+unsigned long limit = DEFAULT_LIMIT;
+char* outDir = "fuzz-out";
+
+Shared* shared;
+int workerId;
+
+// this worker's corpus
+Input* corpus;
+int corpusCount;
+int corpusCapacity;
+
+// edges of the current run, and which map entries they set
+unsigned char hits[FUZZ_MAP_SIZE];
+unsigned short touched[FUZZ_MAP_SIZE];
+int touchedCount;
+
+// pages the current run wrote, restored from the snapshot by the next run
+unsigned char dirty[65536 / PAGE_WORDS];
+unsigned char dirtyPages[65536 / PAGE_WORDS];
+int dirtyCount;
+unsigned long long restores;
+
+// where the current run is, global so they survive a siglongjmp
+unsigned long cycles;
+unsigned short lastPC;
+sigjmp_buf escape;
+
+unsigned int rng;
+volatile sig_atomic_t stopping = 0;
+
+//helpers:
+static void stop(int sig) {
+  stopping = 1;
+}
+
+// the simulator crashed mid instruction: abandon the run
+static void crashed(int sig) {
+  siglongjmp(escape, 1);
+}
+
+static unsigned int randomNumber(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static void markDirty(unsigned short address) {
+  unsigned char page = address / PAGE_WORDS;
+  if (!dirty[page]) {
+    dirty[page] = 1;
+    dirtyPages[dirtyCount++] = page;
+  }
+}
+
+// put machine back into the snapshot state. Copying back only the dirty
+// pages is correct as long as guest memory changes only through the input
+// regions, the keyboard registers and STR, which runInput all mark. Every
+// RESTORE_CHECK_INTERVAL runs the whole memory is compared with the
+// snapshot, so a write path that isn't marked stops the fuzzer instead of
+// quietly leaking state from one input into the next.
+static void restore(void) {
+  memcpy(&machine, &snapshot, offsetof(MachineState, memory));
+  for (int i = 0; i < dirtyCount; i++) {
+    int page = dirtyPages[i];
+    memcpy(&machine.memory[page * PAGE_WORDS], &snapshot.memory[page * PAGE_WORDS],
+      PAGE_WORDS * sizeof(unsigned short));
+    dirty[page] = 0;
+  }
+  dirtyCount = 0;
+
+  restores++;
+  if (restores % RESTORE_CHECK_INTERVAL == 0 && memcmp(machine.memory, snapshot.memory, sizeof(machine.memory)) != 0) {
+    fprintf(stderr, "worker %d: a run changed memory outside the pages it marked dirty\n", workerId);
+    if (shared != NULL) {
+      shared -> stop = 1;
+    }
+    exit(1);
+  }
+}
+
+static void recordEdge(unsigned short from, unsigned short to) {
+  unsigned int edge = ((from * 40503u) ^ to) & (FUZZ_MAP_SIZE - 1);
+  if (!hits[edge]) {
+    hits[edge] = 1;
+    touched[touchedCount++] = edge;
+  }
+}
+
+// publish the run's edges; returns how many no worker had reached before
+static int mergeCoverage(void) {
+  int fresh = 0;
+  for (int i = 0; i < touchedCount; i++) {
+    unsigned short edge = touched[i];
+    hits[edge] = 0;
+    if (shared -> edges[edge] == 0 && __sync_bool_compare_and_swap(&shared -> edges[edge], 0, 1)) {
+      fresh++;
+    }
+  }
+  touchedCount = 0;
+  if (fresh > 0) {
+    __sync_fetch_and_add(&shared -> edgeCount, fresh);
+  }
+  return fresh;
+}
+
+// run one input from the snapshot
+static int runInput(unsigned char* bytes, int length) {
+  restore();
+  int at = 0;
+  for (int r = 0; r < regionCount; r++) {
+    for (int w = 0; w < regions[r].words; w++) {
+      unsigned short address = regions[r].address + w;
+      machine.memory[address] = bytes[at] << 8 | bytes[at + 1];
+      markDirty(address);
+      at += 2;
+    }
+  }
+  if (machine.keyboard != NULL) {
+    keyboard.keys = bytes + regionBytes;
+    keyboard.length = length - regionBytes;
+    keyboard.next = 0;
+    keyboard.drained = 0;
+    markDirty(KBSR);
+  }
+
+  cycles = 0;
+  lastPC = machine.PC;
+  if (sigsetjmp(escape, 1) != 0) {
+    return RUN_CRASH;
+  }
+  while (machine.PC != 0x80FF) {
+    if (cycles >= limit) {
+      return RUN_LIMIT;
+    }
+    unsigned short pc = machine.PC;
+    unsigned short op = machine.memory[pc] >> 12;
+    lastPC = pc;
+    if (UpdateMachineState(&machine, NULL) == -1) {
+      return RUN_FAULT;
+    }
+    cycles++;
+    if (op == 7) {
+      markDirty(machine.dmemAddr);
+    } else if (op == 0 || op == 4 || op == 8 || op == 12 || op == 15) {
+      recordEdge(pc, machine.PC);
+    }
+    if (keyboard.drained) {
+      return RUN_DRAINED;
+    }
+  }
+  return (machine.fault == FAULT_NONE) ? RUN_HALTED : RUN_FAULT;
+}
+
+static int addToCorpus(unsigned char* bytes, int length) {
+  if (corpusCount == corpusCapacity) {
+    int capacity = corpusCapacity ? 2 * corpusCapacity : 64;
+    Input* grown = realloc(corpus, capacity * sizeof(Input));
+    if (grown == NULL) {
+      return -1;
+    }
+    corpus = grown;
+    corpusCapacity = capacity;
+  }
+  unsigned char* copy = malloc(length > 0 ? length : 1);
+  if (copy == NULL) {
+    return -1;
+  }
+  memcpy(copy, bytes, length);
+  corpus[corpusCount].bytes = copy;
+  corpus[corpusCount].length = length;
+  corpusCount++;
+  return 0;
+}
+
+static void saveInput(const char* kind, unsigned long long id, unsigned char* bytes, int length) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/%s/w%02d-%06llu", outDir, kind, workerId, id);
+  FILE* file = fopen(path, "wb");
+  if (file != NULL) {
+    fwrite(bytes, 1, length, file);
+    fclose(file);
+  }
+}
+
+// faults and hangs are kept once per site
+static int newOutcome(int outcome) {
+  unsigned int site = ((lastPC * 40503u) ^ (outcome << 13)) & (FUZZ_MAP_SIZE - 1);
+  return shared -> outcomes[site] == 0 && __sync_bool_compare_and_swap(&shared -> outcomes[site], 0, 1);
+}
+
+// values that tend to reach boundaries in comparisons and address arithmetic
+static const unsigned short interesting[] = {
+  0x0000, 0x0001, 0x0002, 0x0010, 0x007F, 0x0080, 0x00FF, 0x0100,
+  0x1FFF, 0x2000, 0x7FFF, 0x8000, 0x8001, 0xA000, 0xFFFE, 0xFFFF,
+};
+
+// a stack of random changes to base, written to out; returns the new length
+static int mutate(unsigned char* out, Input* base) {
+  int length = base -> length;
+  memcpy(out, base -> bytes, length);
+  int rounds = 1 << (1 + randomNumber() % 4);
+
+  for (int i = 0; i < rounds; i++) {
+    unsigned int r = randomNumber();
+    int keys = length - regionBytes;
+    switch (r % 7) {
+      case 0: // flip a bit
+        if (length > 0) {
+          out[(r >> 3) % length] ^= 1 << ((r >> 20) & 7);
+        }
+        break;
+      case 1: // random byte
+        if (length > 0) {
+          out[(r >> 3) % length] = randomNumber();
+        }
+        break;
+      case 2: // interesting word
+        if (length > 1) {
+          int at = (r >> 3) % (length - 1);
+          unsigned short value = interesting[(r >> 24) % 16];
+          out[at] = value >> 8;
+          out[at + 1] = value & 0xFF;
+        }
+        break;
+      case 3: // small add or subtract
+        if (length > 0) {
+          out[(r >> 3) % length] += (int) ((r >> 24) % 35) - 17;
+        }
+        break;
+      case 4: // insert a key, usually a printable one
+        if (maxKeys > 0 && keys < maxKeys) {
+          int at = regionBytes + (r >> 3) % (keys + 1);
+          memmove(out + at + 1, out + at, length - at);
+          out[at] = (r >> 24) % 4 ? ' ' + (randomNumber() % 95) : randomNumber();
+          length++;
+        }
+        break;
+      case 5: // delete a key
+        if (keys > 0) {
+          int at = regionBytes + (r >> 3) % keys;
+          memmove(out + at, out + at + 1, length - at - 1);
+          length--;
+        }
+        break;
+      case 6: { // splice in a chunk of another input at the same offset
+        Input* other = &corpus[(r >> 3) % corpusCount];
+        int shorter = (other -> length < length) ? other -> length : length;
+        if (shorter > 0) {
+          int at = randomNumber() % shorter;
+          int count = 1 + randomNumber() % (shorter - at);
+          memcpy(out + at, other -> bytes + at, count);
+        }
+        break;
+      }
+    }
+  }
+  return length;
+}
+
+// keep inputs that found something; returns how the run ended
+static int runAndTriage(unsigned char* bytes, int length) {
+  int outcome = runInput(bytes, length);
+  // new edges are already marked as seen, so the input has to be kept
+  // however the run ended or nothing reaching them again would be
+  if (mergeCoverage() > 0 && addToCorpus(bytes, length) == 0) {
+    saveInput("queue", __sync_fetch_and_add(&shared -> queued, 1), bytes, length);
+  }
+  if (outcome == RUN_FAULT || outcome == RUN_CRASH) {
+    if (newOutcome(outcome)) {
+      saveInput("faults", __sync_fetch_and_add(&shared -> faults, 1), bytes, length);
+    }
+  } else if (outcome == RUN_LIMIT) {
+    if (newOutcome(outcome)) {
+      saveInput("hangs", __sync_fetch_and_add(&shared -> hangs, 1), bytes, length);
+    }
+  }
+  return outcome;
+}
+
+static void installCrashHandlers(void) {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = crashed;
+  action.sa_flags = SA_NODEFER;
+  sigaction(SIGFPE, &action, NULL);
+  sigaction(SIGSEGV, &action, NULL);
+  sigaction(SIGBUS, &action, NULL);
+}
+
+// the input the snapshot already holds: the regions as loaded and no keys
+static unsigned char* seedInput(void) {
+  unsigned char* seed = malloc(regionBytes + 1);
+  if (seed == NULL) {
+    return NULL;
+  }
+  int at = 0;
+  for (int r = 0; r < regionCount; r++) {
+    for (int w = 0; w < regions[r].words; w++) {
+      unsigned short word = snapshot.memory[(unsigned short) (regions[r].address + w)];
+      seed[at++] = word >> 8;
+      seed[at++] = word & 0xFF;
+    }
+  }
+  return seed;
+}
+
+// worker loop: mutate corpus entries until the parent sets stop
+static void fuzzWorker(int id) {
+  workerId = id;
+  rng = (unsigned int) time(NULL) ^ (id * 2654435761u) ^ (unsigned int) getpid();
+  if (rng == 0) {
+    rng = 1;
+  }
+  signal(SIGINT, SIG_IGN);
+  installCrashHandlers();
+
+  // the simulator reports faults on stdout, which would only slow us down
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    return;
+  }
+
+  unsigned char* buffer = malloc(regionBytes + maxKeys + 1);
+  unsigned char* seed = seedInput();
+  if (buffer == NULL || seed == NULL) {
+    return;
+  }
+  runAndTriage(seed, regionBytes);
+  if (corpusCount == 0 && addToCorpus(seed, regionBytes) == -1) {
+    return;
+  }
+  free(seed);
+
+  unsigned long long pick = 0;
+  unsigned long long pending = 0;
+  while (!shared -> stop) {
+    Input* base = &corpus[pick++ % corpusCount];
+    for (int i = 0; i < MUTATIONS_PER_PICK; i++) {
+      int length = mutate(buffer, base);
+      runAndTriage(buffer, length);
+      // the corpus may have moved
+      base = &corpus[(pick - 1) % corpusCount];
+    }
+    pending += MUTATIONS_PER_PICK;
+    if (pending >= 1024) {
+      __sync_fetch_and_add(&shared -> execs, pending);
+      pending = 0;
+    }
+  }
+  __sync_fetch_and_add(&shared -> execs, pending);
+}
+
+// "x4000:64", "0x4000:64" or "16384:64"
+static int parseRegion(char* text) {
+  if (regionCount == MAX_REGIONS) {
+    printf("at most %d regions\n", MAX_REGIONS);
+    return -1;
+  }
+  char* colon = strchr(text, ':');
+  if (colon == NULL) {
+    printf("region must be <address>:<words>\n");
+    return -1;
+  }
+  char* start = (*text == 'x' || *text == 'X') ? text + 1 : text;
+  long address = strtol(start, NULL, (start != text) ? 16 : 0);
+  long words = atol(colon + 1);
+  if (address < 0 || words < 1 || address + words > 65536) {
+    printf("invalid region %s\n", text);
+    return -1;
+  }
+  regions[regionCount].address = address;
+  regions[regionCount].words = words;
+  regionCount++;
+  regionBytes += 2 * words;
+  return 0;
+}
+
+static int makeDirectory(const char* kind) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s%s%s", outDir, kind[0] ? "/" : "", kind);
+  if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+    printf("could not create %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+static int loadFile(char* filename, MachineState* CPU) {
+  size_t length = strlen(filename);
+  if (length > 4 && strcmp(filename + length - 4, ".asm") == 0) {
+    return AssembleIntoMachine(filename, CPU);
+  }
+  return ReadObjectFile(filename, CPU);
+}
+
+// run one saved input and report how it ended
+static int replay(char* filename) {
+  FILE* file = fopen(filename, "rb");
+  if (file == NULL) {
+    printf("could not open %s\n", filename);
+    return -1;
+  }
+  unsigned char* bytes = malloc(regionBytes + maxKeys + 1);
+  int length = (bytes == NULL) ? 0 : fread(bytes, 1, regionBytes + maxKeys, file);
+  fclose(file);
+  if (bytes == NULL || length < regionBytes) {
+    printf("%s is shorter than the %d bytes of the regions\n", filename, regionBytes);
+    free(bytes);
+    return -1;
+  }
+
+  shared = calloc(1, sizeof(Shared));
+  if (shared == NULL) {
+    free(bytes);
+    return -1;
+  }
+  installCrashHandlers();
+  int outcome = runInput(bytes, length);
+  int edges = touchedCount;
+  mergeCoverage();
+  printf("\n%s after %lu cycles at PC %04X, %d edges\n", outcomeNames[outcome], cycles, lastPC, edges);
+  free(shared);
+  free(bytes);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+
+  int workerCount = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  int seconds = 0;
+  char* replayName = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "m:k:l:w:t:o:r:")) != -1) {
+    switch (opt) {
+      case 'm':
+        if (parseRegion(optarg) == -1) {
+          return -1;
+        }
+        break;
+      case 'k':
+        maxKeys = atoi(optarg);
+        break;
+      case 'l':
+        limit = strtoul(optarg, NULL, 10);
+        break;
+      case 'w':
+        workerCount = atoi(optarg);
+        break;
+      case 't':
+        seconds = atoi(optarg);
+        break;
+      case 'o':
+        outDir = optarg;
+        break;
+      case 'r':
+        replayName = optarg;
+        break;
+      default:
+        printf("usage: fuzz [-m address:words ...] [-k max-keys] [-l cycle-limit] [-w workers] [-t seconds] [-o dir] file.obj ...\n");
+        printf("       fuzz -r input [-m ...] [-k ...] [-l ...] file.obj ...\n");
+        return -1;
+    }
+  }
+  if (regionCount == 0 && maxKeys <= 0) {
+    printf("nothing to fuzz: give memory regions with -m or keyboard input with -k\n");
+    return -1;
+  }
+  if (optind == argc) {
+    printf("invalid number of files\n");
+    return -1;
+  }
+  if (workerCount < 1) {
+    workerCount = 1;
+  }
+  if (workerCount > MAX_WORKERS) {
+    workerCount = MAX_WORKERS;
+  }
+
+  Reset(&snapshot);
+  for (int i = optind; i < argc; i++) {
+    if (loadFile(argv[i], &snapshot) == -1) {
+      printf("could not load %s\n", argv[i]);
+      return -1;
+    }
+  }
+  if (maxKeys > 0) {
+    snapshot.keyboard = &keyboard;
+  }
+  memcpy(&machine, &snapshot, sizeof(MachineState));
+
+  if (replayName != NULL) {
+    return replay(replayName);
+  }
+
+  if (makeDirectory("") == -1 || makeDirectory("queue") == -1 || makeDirectory("faults") == -1 ||
+  makeDirectory("hangs") == -1) {
+    return -1;
+  }
+  shared = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) {
+    printf("could not map shared coverage: %s\n", strerror(errno));
+    return -1;
+  }
+
+  pid_t workers[MAX_WORKERS];
+  fflush(stdout);
+  for (int i = 0; i < workerCount; i++) {
+    workers[i] = fork();
+    if (workers[i] == 0) {
+      fuzzWorker(i);
+      exit(0);
+    }
+  }
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  // report once a second until the time is up or we are interrupted
+  time_t start = time(NULL);
+  unsigned long long lastExecs = 0;
+  while (!stopping && !shared -> stop && (seconds == 0 || time(NULL) - start < seconds)) {
+    sleep(1);
+    unsigned long long execs = shared -> execs;
+    fprintf(stderr, "%lds: %llu execs (%llu/s), %llu edges, %llu queued, %llu faults, %llu hangs\n",
+      (long) (time(NULL) - start), execs, execs - lastExecs, shared -> edgeCount, shared -> queued,
+      shared -> faults, shared -> hangs);
+    lastExecs = execs;
+  }
+
+  shared -> stop = 1;
+  int failed = 0;
+  for (int i = 0; i < workerCount; i++) {
+    int status;
+    if (waitpid(workers[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failed = 1;
+    }
+  }
+  long elapsed = (long) (time(NULL) - start);
+  printf("fuzz: %llu execs in %lds with %d workers, %llu edges, %llu queued, %llu faults, %llu hangs in %s\n",
+    shared -> execs, elapsed, workerCount, shared -> edgeCount, shared -> queued, shared -> faults,
+    shared -> hangs, outDir);
+  munmap(shared, sizeof(Shared));
+  return failed ? -1 : 0;
+}
@@ -7,6 +7,18 @@
 // memory array location
 unsigned short memoryAddress;
 
+// where symbols are reported, if anywhere
+SymbolHandler symbolHandler = NULL;
+void* symbolContext = NULL;
+
+/*
+ * Report every symbol read from now on to handler.
+ */
+void SetSymbolHandler(SymbolHandler handler, void* context) {
+  symbolHandler = handler;
+  symbolContext = context;
+}
+
 /*
  * Read an object file and modify the machine state as described in the writeup
 
@@ -30,9 +42,6 @@ CA DE 00 00 00 0C 90 00 D1 40 92 00 94 0A 25 00 0C 0C 66 00 48 01 72 00 10 21 14
 int ReadObjectFile(char* filename, MachineState* CPU) {
 
   FILE *file;
-  int specifierFirst;
-  int specifierSecond;
-  unsigned short length;
 
   file = fopen(filename, "rb");
 
@@ -42,6 +51,21 @@ int ReadObjectFile(char* filename, MachineState* CPU) {
     return -1;
   }
 
+  int result = ReadObjectStream(file, CPU);
+  fclose(file);
+  return result;
+}
+
+/*
+ * Read object file contents from an already open stream, e.g. an image held
+ * in memory and opened with fmemopen. The stream is left open.
+ */
+int ReadObjectStream(FILE* file, MachineState* CPU) {
+
+  int specifierFirst;
+  int specifierSecond;
+  unsigned short length;
+
   //read in bits
   specifierFirst = fgetc(file);
   specifierSecond = fgetc(file);
@@ -63,6 +87,7 @@ int ReadObjectFile(char* filename, MachineState* CPU) {
         inst = (fgetc(file) << 8 | fgetc(file));
         unsigned short offset = memoryAddress + i;
         CPU -> memory[offset] = inst;
+        InvalidateFusion(CPU, offset);
       }
 
     } else if (specifier == 0xDADA) {
@@ -76,14 +101,23 @@ int ReadObjectFile(char* filename, MachineState* CPU) {
         data = (fgetc(file) << 8 | fgetc(file));
         unsigned short offset = memoryAddress + i;
         CPU -> memory[offset] = data;
+        InvalidateFusion(CPU, offset);
       }
 
     } else if (specifier == 0xC3B7) {
       //read in address, length, symbol
+      char symbol[256];
       memoryAddress = (fgetc(file) << 8 | fgetc(file));
       length = (fgetc(file) << 8 | fgetc(file));
       for (int i = 0; i < length; i++) {
-        fgetc(file);
+        int c = fgetc(file);
+        if (i < (int) sizeof(symbol) - 1) {
+          symbol[i] = c;
+        }
+      }
+      symbol[length < sizeof(symbol) ? length : sizeof(symbol) - 1] = '\0';
+      if (symbolHandler != NULL) {
+        symbolHandler(memoryAddress, symbol, symbolContext);
       }
 
     } else if (specifier == 0xF17E) {
@@ -114,7 +148,6 @@ int ReadObjectFile(char* filename, MachineState* CPU) {
     
   }
 
-  fclose(file);
   return 0;
   
 }
@@ -6,4 +6,13 @@
 #include "LC4.h"
 
 // Read an object file and modify the machine state as described in the writeup
-int ReadObjectFile(char* filename, MachineState* CPU);
\ No newline at end of file
+int ReadObjectFile(char* filename, MachineState* CPU);
+
+// Same as ReadObjectFile, but reads from a stream that is already open
+int ReadObjectStream(FILE* file, MachineState* CPU);
+
+// Receives the address and name of each symbol section read by the loader
+typedef void (*SymbolHandler)(unsigned short address, char* name, void* context);
+
+// Report symbols from every object read after this call, NULL stops reporting
+void SetSymbolHandler(SymbolHandler handler, void* context);
@@ -0,0 +1,274 @@
+/*
+ * pipeline.c: Defines a 5-stage (F D X M W) pipeline timing model
+ *
+ * The model replays the retired instruction stream; it does not execute
+ * anything itself. The pipeline is fully bypassed, so the only hazards are:
+ *   - load-use: an LDR followed by an instruction that needs its result in X
+ *     (or a BR, which needs the NZP bits the LDR sets) costs 1 cycle.
+ *     A STR that only needs the loaded value as its data is bypassed in M.
+ *   - branches: conditional branches resolve in X, so a wrong direction
+ *     prediction costs 2 cycles. There is no BTB, so the target of a branch
+ *     predicted taken is only known in D and fetch loses 1 cycle to it.
+ *   - jumps: JMP, JMPR, JSR, JSRR, TRAP and RTI always redirect fetch from X
+ *     and cost 2 cycles.
+ */
+
+#include "pipeline.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INSN_OP(I) ((I) >> 12) // EXTRACTS [15:12]
+#define INSN_11th_bit(I) (((I) >> 11) & 0x1) // 11
+#define INSN_dest(I) (((I) >> 9) & 0x7) // EXTRACTS [11:9]
+#define INSN_s(I) (((I) >> 6) & 0x7) // EXTRACTS [8:6]
+#define INSN_ar_type(I) (((I) >> 3) & 0x7) // EXTRACTS [5:3]
+#define INSN_t(I) ((I) & 0x7) // EXTRACTS [2:0]
+#define INSN_5th_bit(I) (((I) >> 5) & 0x1) // EXTRACTS [5]
+#define INSN_comp_type(I) (((I) >> 7) & 0x3) // EXTRACTS [8:7]
+#define INSN_mod_shift_type(I) (((I) >> 4) & 0x3) // EXTRACTS [5:4]
+
+#define FILL_CYCLES 4
+#define REDIRECT_CYCLES 2
+#define DECODE_REDIRECT_CYCLES 1
+#define REPORT_PCS 20
+
+static const char* stallNames[STALL_CAUSES] = { "load-use", "branch", "jump" };
+
+/*
+ * Set up the timing model with the requested predictor.
+ */
+int PipelineInit(PipelineModel* pipe, char* config)
+{
+  char name[16];
+  int bits = 10;
+  char* colon = strchr(config, ':');
+  size_t len = (colon == NULL) ? strlen(config) : (size_t) (colon - config);
+
+  if (len >= sizeof(name)) {
+    printf("invalid branch predictor: %s\n", config);
+    return -1;
+  }
+  memcpy(name, config, len);
+  name[len] = '\0';
+  if (colon != NULL) {
+    bits = atoi(colon + 1);
+  }
+
+  memset(pipe, 0, sizeof(PipelineModel));
+  if (strcmp(name, "not-taken") == 0) {
+    pipe -> predictor = PREDICT_NOT_TAKEN;
+  } else if (strcmp(name, "bimodal") == 0) {
+    pipe -> predictor = PREDICT_BIMODAL;
+  } else if (strcmp(name, "gshare") == 0) {
+    pipe -> predictor = PREDICT_GSHARE;
+  } else {
+    printf("invalid branch predictor: %s\n", config);
+    return -1;
+  }
+  if (bits < 1 || bits > 16) {
+    printf("predictor table bits must be between 1 and 16\n");
+    return -1;
+  }
+  pipe -> tableBits = bits;
+
+  // counters start weakly not-taken
+  pipe -> counters = malloc(1 << bits);
+  pipe -> pcInsns = calloc(65536, sizeof(unsigned int));
+  int failed = pipe -> counters == NULL || pipe -> pcInsns == NULL;
+  for (int i = 0; i < STALL_CAUSES; i++) {
+    pipe -> pcStalls[i] = calloc(65536, sizeof(unsigned int));
+    failed |= pipe -> pcStalls[i] == NULL;
+  }
+  if (failed) {
+    printf("could not allocate pipeline model\n");
+    PipelineFree(pipe);
+    return -1;
+  }
+  memset(pipe -> counters, 1, 1 << bits);
+  return 0;
+}
+
+//helpers:
+// bitmask of the registers insn reads in X; *dataOnly gets the STR data register mask
+static int sourceRegs(unsigned short insn, int* dataOnly) {
+  unsigned short s = 1 << INSN_s(insn);
+  unsigned short t = 1 << INSN_t(insn);
+  *dataOnly = 0;
+  switch (INSN_OP(insn)) {
+    case 1: // arithmetic
+      return INSN_5th_bit(insn) ? s : (s | t);
+    case 2: // compare, rs lives in [11:9]
+      return (INSN_comp_type(insn) < 2) ? ((1 << INSN_dest(insn)) | t) : (1 << INSN_dest(insn));
+    case 4: // jsrr
+    case 12: // jmpr
+      return INSN_11th_bit(insn) ? 0 : s;
+    case 5: // logical
+      if (INSN_5th_bit(insn) || INSN_ar_type(insn) == 1) {
+        return s;
+      }
+      return s | t;
+    case 6: // ldr
+      return s;
+    case 7: // str
+      *dataOnly = t & ~s;
+      return s | t;
+    case 8: // rti
+      return 1 << 7;
+    case 10: // shift/mod
+      return (INSN_mod_shift_type(insn) == 3) ? (s | t) : s;
+    case 13: // hiconst
+      return 1 << INSN_dest(insn);
+    default:
+      return 0;
+  }
+}
+
+// predict the direction of the conditional branch at pc
+static int predictTaken(PipelineModel* pipe, unsigned short pc, unsigned int* index) {
+  unsigned int mask = (1 << pipe -> tableBits) - 1;
+  if (pipe -> predictor == PREDICT_NOT_TAKEN) {
+    return 0;
+  }
+  *index = pc & mask;
+  if (pipe -> predictor == PREDICT_GSHARE) {
+    *index = (pc ^ pipe -> history) & mask;
+  }
+  return pipe -> counters[*index] >= 2;
+}
+
+// train the predictor with the actual branch outcome
+static void trainPredictor(PipelineModel* pipe, unsigned int index, int taken) {
+  if (pipe -> predictor == PREDICT_NOT_TAKEN) {
+    return;
+  }
+  if (taken && pipe -> counters[index] < 3) {
+    pipe -> counters[index]++;
+  } else if (!taken && pipe -> counters[index] > 0) {
+    pipe -> counters[index]--;
+  }
+  pipe -> history = (pipe -> history << 1) | taken;
+}
+
+static void addStall(PipelineModel* pipe, unsigned short pc, int cause, unsigned int cycles) {
+  pipe -> stalls[cause] += cycles;
+  pipe -> pcStalls[cause][pc] += cycles;
+}
+
+/*
+ * Replay one retired instruction through the pipeline.
+ */
+void PipelineStep(PipelineModel* pipe, unsigned short pc, unsigned short insn, unsigned short nextPC)
+{
+  unsigned short op = INSN_OP(insn);
+  int taken = nextPC != (unsigned short) (pc + 1);
+
+  pipe -> insns++;
+  pipe -> pcInsns[pc]++;
+
+  // load-use: the previous LDR's value is only ready at the end of M
+  if (pipe -> prevValid && INSN_OP(pipe -> prevInsn) == 6) {
+    int loaded = 1 << INSN_dest(pipe -> prevInsn);
+    int dataOnly;
+    int reads = sourceRegs(insn, &dataOnly);
+    if (op == 0 || ((reads & loaded) && !(dataOnly & loaded))) {
+      addStall(pipe, pc, STALL_LOAD_USE, 1);
+    }
+  }
+
+  if (op == 0) {
+    unsigned int index = 0;
+    pipe -> branches++;
+    if (predictTaken(pipe, pc, &index) != taken) {
+      pipe -> mispredicts++;
+      addStall(pipe, pc, STALL_BRANCH, REDIRECT_CYCLES);
+    } else if (taken) {
+      addStall(pipe, pc, STALL_BRANCH, DECODE_REDIRECT_CYCLES);
+    }
+    trainPredictor(pipe, index, taken);
+  } else if (op == 4 || op == 8 || op == 12 || op == 15) {
+    addStall(pipe, pc, STALL_JUMP, REDIRECT_CYCLES);
+  }
+
+  pipe -> prevValid = 1;
+  pipe -> prevInsn = insn;
+}
+
+/*
+ * Write the CPI breakdown and the PCs that lost the most cycles.
+ */
+void PipelineReport(PipelineModel* pipe, FILE* output)
+{
+  static const char* predictorNames[] = { "not-taken", "bimodal", "gshare" };
+  unsigned long long stallTotal = 0;
+  for (int i = 0; i < STALL_CAUSES; i++) {
+    stallTotal += pipe -> stalls[i];
+  }
+  unsigned long long cycles = pipe -> insns + stallTotal + (pipe -> insns ? FILL_CYCLES : 0);
+  double insns = pipe -> insns ? (double) pipe -> insns : 1.0;
+
+  fprintf(output, "pipeline: predictor %s", predictorNames[pipe -> predictor]);
+  if (pipe -> predictor != PREDICT_NOT_TAKEN) {
+    fprintf(output, " (%d entries)", 1 << pipe -> tableBits);
+  }
+  fprintf(output, "\n");
+  fprintf(output, "  instructions  %llu\n", pipe -> insns);
+  fprintf(output, "  cycles        %llu\n", cycles);
+  fprintf(output, "  CPI           %.3f\n", cycles / insns);
+  fprintf(output, "    %-17s %.3f\n", "base", 1.0);
+  fprintf(output, "    %-17s %.3f\n", "fill", (cycles - pipe -> insns - stallTotal) / insns);
+  for (int i = 0; i < STALL_CAUSES; i++) {
+    fprintf(output, "    %-17s %.3f (%llu cycles)\n", stallNames[i], pipe -> stalls[i] / insns, pipe -> stalls[i]);
+  }
+  fprintf(output, "  branches      %llu, mispredicted %llu", pipe -> branches, pipe -> mispredicts);
+  if (pipe -> branches) {
+    fprintf(output, " (%.2f%%)", 100.0 * pipe -> mispredicts / pipe -> branches);
+  }
+  fprintf(output, "\n");
+
+  // repeatedly pick the PC with the most stall cycles that has not been printed
+  unsigned int printedBelow = 0xFFFFFFFF;
+  int printedPC = -1;
+  int shown = 0;
+  fprintf(output, "  top stalling PCs:\n");
+  fprintf(output, "    PC    count      load-use   branch     jump       CPI\n");
+  while (shown < REPORT_PCS) {
+    unsigned int best = 0;
+    int bestPC = -1;
+    for (int pc = 0; pc < 65536; pc++) {
+      unsigned int total = 0;
+      for (int i = 0; i < STALL_CAUSES; i++) {
+        total += pipe -> pcStalls[i][pc];
+      }
+      // ties are broken by PC so every PC is visited once
+      if (total == 0 || total > printedBelow || (total == printedBelow && pc <= printedPC)) {
+        continue;
+      }
+      if (total > best) {
+        best = total;
+        bestPC = pc;
+      }
+    }
+    if (bestPC < 0) {
+      break;
+    }
+    fprintf(output, "    %04X  %-10u %-10u %-10u %-10u %.3f\n", bestPC, pipe -> pcInsns[bestPC],
+      pipe -> pcStalls[STALL_LOAD_USE][bestPC], pipe -> pcStalls[STALL_BRANCH][bestPC],
+      pipe -> pcStalls[STALL_JUMP][bestPC], 1.0 + (double) best / pipe -> pcInsns[bestPC]);
+    printedBelow = best;
+    printedPC = bestPC;
+    shown++;
+  }
+}
+
+/*
+ * Release the predictor table and per-PC counters.
+ */
+void PipelineFree(PipelineModel* pipe)
+{
+  free(pipe -> counters);
+  free(pipe -> pcInsns);
+  for (int i = 0; i < STALL_CAUSES; i++) {
+    free(pipe -> pcStalls[i]);
+  }
+  memset(pipe, 0, sizeof(PipelineModel));
+}
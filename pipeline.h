@@ -0,0 +1,70 @@
+/*
+ * pipeline.h: Declares a 5-stage pipeline timing model for executed instructions
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+
+// Branch predictors the timing model can use for conditional branches
+#define PREDICT_NOT_TAKEN 0
+#define PREDICT_BIMODAL 1
+#define PREDICT_GSHARE 2
+
+// Stall causes tracked per PC
+#define STALL_LOAD_USE 0
+#define STALL_BRANCH 1
+#define STALL_JUMP 2
+#define STALL_CAUSES 3
+
+typedef struct {
+    // which predictor is used, and log2 of its number of 2-bit counters
+    int predictor;
+    int tableBits;
+    unsigned char* counters;
+    unsigned short history;
+
+    // the previously retired instruction, used for load-use detection
+    int prevValid;
+    unsigned short prevInsn;
+
+    // totals across the whole run
+    unsigned long long insns;
+    unsigned long long branches;
+    unsigned long long mispredicts;
+    unsigned long long stalls[STALL_CAUSES];
+
+    // per-PC counts: instructions retired and stall cycles by cause
+    unsigned int* pcInsns;
+    unsigned int* pcStalls[STALL_CAUSES];
+} PipelineModel;
+
+
+/*
+ * Set up the timing model. config is "not-taken", "bimodal" or "gshare",
+ * optionally followed by ":<bits>" to size the predictor table.
+ * Returns -1 if the config is invalid.
+ */
+int PipelineInit(PipelineModel* pipe, char* config);
+
+
+/*
+ * Replay one retired instruction: the PC it was at, the instruction word,
+ * and the PC the machine moved to after executing it.
+ */
+void PipelineStep(PipelineModel* pipe, unsigned short pc, unsigned short insn, unsigned short nextPC);
+
+
+/*
+ * Write the CPI breakdown by stall cause and the costliest PCs to output.
+ */
+void PipelineReport(PipelineModel* pipe, FILE* output);
+
+
+/*
+ * Release the predictor table and per-PC counters.
+ */
+void PipelineFree(PipelineModel* pipe);
+
+#endif
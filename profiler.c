@@ -0,0 +1,272 @@
+/*
+ * profiler.c: Defines a call-graph profiler driven by calls and returns in the guest
+ *
+ * The profiler keeps a shadow call stack next to the guest's R7 convention:
+ * JSR, JSRR and TRAP push a frame for the routine they jump to, JMPR R7 and
+ * RTI pop it. Every retired instruction is charged to the calling context
+ * (the chain of open frames) it ran in, which gives exact exclusive counts
+ * per context; inclusive counts come from the instruction count when each
+ * frame closes. A return with no open frame, like the RTI the OS uses to
+ * drop into user code, starts a new root context at its target.
+ */
+
+#include "profiler.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INSN_OP(I) ((I) >> 12) // EXTRACTS [15:12]
+#define INSN_11th_bit(I) (((I) >> 11) & 0x1) // 11
+#define INSN_s(I) (((I) >> 6) & 0x7) // EXTRACTS [8:6]
+
+/*
+ * Set up a profiler whose first frame starts at entry.
+ */
+int ProfilerInit(Profiler* profiler, unsigned short entry)
+{
+  memset(profiler, 0, sizeof(Profiler));
+  profiler -> nodeCapacity = 1024;
+  profiler -> nodes = malloc(profiler -> nodeCapacity * sizeof(CallNode));
+  profiler -> self = calloc(65536, sizeof(unsigned long long));
+  profiler -> inclusive = calloc(65536, sizeof(unsigned long long));
+  profiler -> calls = calloc(65536, sizeof(unsigned long long));
+  profiler -> active = calloc(65536, sizeof(unsigned int));
+  profiler -> names = calloc(65536, sizeof(char*));
+  if (profiler -> nodes == NULL || profiler -> self == NULL || profiler -> inclusive == NULL ||
+  profiler -> calls == NULL || profiler -> active == NULL || profiler -> names == NULL) {
+    printf("could not allocate profiler\n");
+    ProfilerFree(profiler);
+    return -1;
+  }
+
+  CallNode* root = &profiler -> nodes[0];
+  memset(root, 0, sizeof(CallNode));
+  root -> entry = entry;
+  root -> parent = -1;
+  root -> firstChild = -1;
+  root -> nextSibling = -1;
+  root -> calls = 1;
+  profiler -> nodeCount = 1;
+
+  profiler -> stack[0] = 0;
+  profiler -> depth = 1;
+  profiler -> calls[entry] = 1;
+  profiler -> active[entry] = 1;
+  return 0;
+}
+
+//helpers:
+// compiler generated local labels look like L123_NAME
+static int isLocalLabel(char* name) {
+  return name[0] == 'L' && name[1] >= '0' && name[1] <= '9';
+}
+
+/*
+ * Name the routine at address, preferring names that are not local labels.
+ */
+void ProfilerAddSymbol(unsigned short address, char* name, void* context)
+{
+  Profiler* profiler = context;
+  char* current = profiler -> names[address];
+  if (current != NULL && !(isLocalLabel(current) && !isLocalLabel(name))) {
+    return;
+  }
+  free(current);
+  profiler -> names[address] = strdup(name);
+}
+
+// the node for entry called from parent, created on first use; parent -1 means a root
+static int childOf(Profiler* profiler, int parent, unsigned short entry) {
+  int node = (parent < 0) ? 0 : profiler -> nodes[parent].firstChild;
+  while (node >= 0) {
+    if (profiler -> nodes[node].entry == entry) {
+      return node;
+    }
+    node = profiler -> nodes[node].nextSibling;
+  }
+
+  if (profiler -> nodeCount == profiler -> nodeCapacity) {
+    CallNode* grown = realloc(profiler -> nodes, 2 * profiler -> nodeCapacity * sizeof(CallNode));
+    if (grown == NULL) {
+      // out of memory: keep charging the caller rather than stopping the run
+      return (parent < 0) ? 0 : parent;
+    }
+    profiler -> nodes = grown;
+    profiler -> nodeCapacity *= 2;
+  }
+
+  node = profiler -> nodeCount++;
+  CallNode* created = &profiler -> nodes[node];
+  memset(created, 0, sizeof(CallNode));
+  created -> entry = entry;
+  created -> parent = parent;
+  created -> firstChild = -1;
+  if (parent < 0) {
+    created -> nextSibling = profiler -> nodes[0].nextSibling;
+    profiler -> nodes[0].nextSibling = node;
+  } else {
+    created -> nextSibling = profiler -> nodes[parent].firstChild;
+    profiler -> nodes[parent].firstChild = node;
+  }
+  return node;
+}
+
+static void pushFrame(Profiler* profiler, unsigned short entry) {
+  if (profiler -> depth == PROFILER_MAX_DEPTH) {
+    profiler -> overflow++;
+    return;
+  }
+  int parent = (profiler -> depth == 0) ? -1 : profiler -> stack[profiler -> depth - 1];
+  int node = childOf(profiler, parent, entry);
+  profiler -> nodes[node].calls++;
+  profiler -> calls[entry]++;
+  profiler -> active[entry]++;
+  profiler -> stack[profiler -> depth] = node;
+  profiler -> entered[profiler -> depth] = profiler -> insns;
+  profiler -> depth++;
+}
+
+// close the innermost frame; recursive routines only count their outermost frame
+static void popFrame(Profiler* profiler) {
+  profiler -> depth--;
+  unsigned short entry = profiler -> nodes[profiler -> stack[profiler -> depth]].entry;
+  profiler -> active[entry]--;
+  if (profiler -> active[entry] == 0) {
+    profiler -> inclusive[entry] += profiler -> insns - profiler -> entered[profiler -> depth];
+  }
+}
+
+/*
+ * Account for one retired instruction and follow calls and returns.
+ */
+void ProfilerStep(Profiler* profiler, unsigned short insn, unsigned short nextPC)
+{
+  unsigned short op = INSN_OP(insn);
+  CallNode* node = &profiler -> nodes[profiler -> stack[profiler -> depth - 1]];
+
+  profiler -> insns++;
+  node -> self++;
+  profiler -> self[node -> entry]++;
+
+  if (op == 4 || op == 15) {
+    // JSR, JSRR, TRAP
+    pushFrame(profiler, nextPC);
+  } else if (op == 8 || (op == 12 && INSN_11th_bit(insn) == 0 && INSN_s(insn) == 7)) {
+    // RTI, RET
+    if (profiler -> overflow > 0) {
+      profiler -> overflow--;
+      return;
+    }
+    popFrame(profiler);
+    if (profiler -> depth == 0) {
+      pushFrame(profiler, nextPC);
+    }
+  }
+}
+
+// the symbol for entry, or a name made from its address
+static const char* routineName(Profiler* profiler, unsigned short entry, char* buffer) {
+  if (profiler -> names[entry] != NULL) {
+    return profiler -> names[entry];
+  }
+  if (entry >= 0x8000 && entry <= 0x80FF) {
+    sprintf(buffer, "TRAP_x%02X", entry & 0xFF);
+  } else {
+    sprintf(buffer, "x%04X", entry);
+  }
+  return buffer;
+}
+
+// qsort has no context argument, so the comparison reads the profiler from here
+static Profiler* sorting;
+
+static int byInclusive(const void* a, const void* b) {
+  unsigned long long x = sorting -> inclusive[*(const int*) a];
+  unsigned long long y = sorting -> inclusive[*(const int*) b];
+  if (x != y) {
+    return (x < y) ? 1 : -1;
+  }
+  return *(const int*) a - *(const int*) b;
+}
+
+/*
+ * Write call counts and inclusive/exclusive instruction counts per routine.
+ * Frames still open at the end of the run are closed first.
+ */
+void ProfilerReport(Profiler* profiler, FILE* output)
+{
+  while (profiler -> depth > 0) {
+    popFrame(profiler);
+  }
+  profiler -> overflow = 0;
+
+  int* routines = malloc(65536 * sizeof(int));
+  int count = 0;
+  if (routines == NULL) {
+    return;
+  }
+  for (int entry = 0; entry < 65536; entry++) {
+    if (profiler -> calls[entry] > 0) {
+      routines[count++] = entry;
+    }
+  }
+  sorting = profiler;
+  qsort(routines, count, sizeof(int), byInclusive);
+
+  double total = profiler -> insns ? (double) profiler -> insns : 1.0;
+  fprintf(output, "profile: %llu instructions, %d routines, %d calling contexts\n",
+    profiler -> insns, count, profiler -> nodeCount);
+  fprintf(output, "  entry  calls      inclusive            exclusive            name\n");
+  for (int i = 0; i < count; i++) {
+    char buffer[16];
+    int entry = routines[i];
+    fprintf(output, "  %04X   %-10llu %-12llu %5.1f%%  %-12llu %5.1f%%  %s\n", entry, profiler -> calls[entry],
+      profiler -> inclusive[entry], 100.0 * profiler -> inclusive[entry] / total,
+      profiler -> self[entry], 100.0 * profiler -> self[entry] / total, routineName(profiler, entry, buffer));
+  }
+  free(routines);
+}
+
+/*
+ * Write one "outer;...;inner count" line per calling context that ran code.
+ */
+void ProfilerWriteFolded(Profiler* profiler, FILE* output)
+{
+  int* path = malloc(profiler -> nodeCount * sizeof(int));
+  if (path == NULL) {
+    return;
+  }
+  for (int node = 0; node < profiler -> nodeCount; node++) {
+    if (profiler -> nodes[node].self == 0) {
+      continue;
+    }
+    int length = 0;
+    for (int at = node; at >= 0; at = profiler -> nodes[at].parent) {
+      path[length++] = at;
+    }
+    for (int i = length - 1; i >= 0; i--) {
+      char buffer[16];
+      fprintf(output, "%s%s", routineName(profiler, profiler -> nodes[path[i]].entry, buffer), i ? ";" : " ");
+    }
+    fprintf(output, "%llu\n", profiler -> nodes[node].self);
+  }
+  free(path);
+}
+
+/*
+ * Release the call tree, counters and names.
+ */
+void ProfilerFree(Profiler* profiler)
+{
+  if (profiler -> names != NULL) {
+    for (int i = 0; i < 65536; i++) {
+      free(profiler -> names[i]);
+    }
+  }
+  free(profiler -> names);
+  free(profiler -> nodes);
+  free(profiler -> self);
+  free(profiler -> inclusive);
+  free(profiler -> calls);
+  free(profiler -> active);
+  memset(profiler, 0, sizeof(Profiler));
+}
@@ -0,0 +1,84 @@
+/*
+ * profiler.h: Declares a call-graph profiler driven by calls and returns in the guest
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+
+#define PROFILER_MAX_DEPTH 4096
+
+// One calling context: a routine reached through a particular chain of callers
+typedef struct {
+    unsigned short entry;
+    int parent;
+    int firstChild;
+    int nextSibling;
+    unsigned long long self;
+    unsigned long long calls;
+} CallNode;
+
+typedef struct {
+    // calling context tree, node 0 is the first root
+    CallNode* nodes;
+    int nodeCount;
+    int nodeCapacity;
+
+    // shadow call stack: the node of each open frame and when it was entered
+    int stack[PROFILER_MAX_DEPTH];
+    unsigned long long entered[PROFILER_MAX_DEPTH];
+    int depth;
+    int overflow;
+
+    unsigned long long insns;
+
+    // per routine totals, indexed by entry address
+    unsigned long long* self;
+    unsigned long long* inclusive;
+    unsigned long long* calls;
+    unsigned int* active;
+
+    // symbol names from the object files, indexed by address
+    char** names;
+} Profiler;
+
+
+/*
+ * Set up a profiler whose first frame starts at entry. Returns -1 on failure.
+ */
+int ProfilerInit(Profiler* profiler, unsigned short entry);
+
+
+/*
+ * Name the routine at address, used as a SymbolHandler while loading.
+ */
+void ProfilerAddSymbol(unsigned short address, char* name, void* context);
+
+
+/*
+ * Account for one retired instruction. JSR, JSRR and TRAP push a frame for
+ * nextPC, JMPR R7 (RET) and RTI pop one.
+ */
+void ProfilerStep(Profiler* profiler, unsigned short insn, unsigned short nextPC);
+
+
+/*
+ * Write call counts and inclusive/exclusive instruction counts per routine.
+ */
+void ProfilerReport(Profiler* profiler, FILE* output);
+
+
+/*
+ * Write one line per calling context, "outer;...;inner count", the folded
+ * stack format flame graph tools read.
+ */
+void ProfilerWriteFolded(Profiler* profiler, FILE* output);
+
+
+/*
+ * Release the call tree, counters and names.
+ */
+void ProfilerFree(Profiler* profiler);
+
+#endif
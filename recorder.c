@@ -0,0 +1,89 @@
+/*
+ * recorder.c: Defines the flight recorder
+ *
+ * Recording a cycle is a copy into a fixed ring, so a run can keep the
+ * recorder on at close to untraced speed and still have the cycles leading
+ * up to a fault when it dies.
+ */
+
+#include "recorder.h"
+
+static const char* faultNames[] = { "halt", "Invalid PC", "Invalid memory address", "Invalid instruction" };
+
+/*
+ * Allocate a ring holding the last capacity cycles.
+ */
+int RecorderInit(FlightRecorder* recorder, int capacity)
+{
+  memset(recorder, 0, sizeof(FlightRecorder));
+  if (capacity < 1) {
+    printf("flight recorder needs room for at least 1 cycle\n");
+    return -1;
+  }
+  recorder -> records = malloc(capacity * sizeof(TraceRecord));
+  if (recorder -> records == NULL) {
+    printf("could not allocate flight recorder\n");
+    return -1;
+  }
+  recorder -> capacity = capacity;
+  return 0;
+}
+
+/*
+ * Store the cycle WriteOut is about to print, or the cycle that faulted,
+ * overwriting the oldest one.
+ */
+void RecordCycle(FlightRecorder* recorder, MachineState* CPU)
+{
+  CaptureRecord(CPU, &recorder -> records[recorder -> next]);
+  recorder -> next++;
+  if (recorder -> next == recorder -> capacity) {
+    recorder -> next = 0;
+  }
+  recorder -> cycles++;
+}
+
+/*
+ * Write the reason, the recorded cycles oldest first, and a register snapshot.
+ */
+void RecorderDump(FlightRecorder* recorder, MachineState* CPU, const char* reason, FILE* output)
+{
+  int count = recorder -> capacity;
+  int start = recorder -> next;
+  if (reason == NULL) {
+    reason = faultNames[CPU -> fault];
+  }
+  if (recorder -> cycles < (unsigned long long) recorder -> capacity) {
+    count = (int) recorder -> cycles;
+    start = 0;
+  }
+
+  fprintf(output, "# flight recorder: %s after %llu cycles, last %d follow\n", reason, recorder -> cycles, count);
+  for (int i = 0; i < count; i++) {
+    TraceRecord* record = &recorder -> records[(start + i) % recorder -> capacity];
+    WriteRecord(record, output);
+    if (record -> fault != FAULT_NONE) {
+      fprintf(output, "# %s on the cycle above\n", faultNames[record -> fault]);
+    }
+  }
+
+  unsigned short psr = CPU -> PSR;
+  fprintf(output, "# PC=%04X PSR=%04X (%s, %c%c%c)\n", CPU -> PC, psr,
+    (psr & 0x8000) ? "OS" : "user", (psr & 0x4) ? 'N' : '-', (psr & 0x2) ? 'Z' : '-', (psr & 0x1) ? 'P' : '-');
+  fprintf(output, "#");
+  for (int i = 0; i < 8; i++) {
+    fprintf(output, " R%d=%04X", i, CPU -> R[i]);
+  }
+  fprintf(output, "\n");
+  fflush(output);
+}
+
+/*
+ * Release the ring.
+ */
+void RecorderFree(FlightRecorder* recorder)
+{
+  free(recorder -> records);
+  recorder -> records = NULL;
+  recorder -> capacity = 0;
+}
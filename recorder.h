@@ -0,0 +1,47 @@
+/*
+ * recorder.h: Declares the flight recorder, a ring of the most recent trace records
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "LC4.h"
+
+typedef struct FlightRecorder {
+    // capacity records, next is where the following cycle will be stored
+    TraceRecord* records;
+    int capacity;
+    int next;
+
+    // cycles recorded since the start of the run
+    unsigned long long cycles;
+} FlightRecorder;
+
+
+/*
+ * Allocate a ring holding the last capacity cycles. Returns -1 on failure.
+ */
+int RecorderInit(FlightRecorder* recorder, int capacity);
+
+
+/*
+ * Store the cycle WriteOut is about to print, or the cycle that faulted,
+ * overwriting the oldest one.
+ */
+void RecordCycle(FlightRecorder* recorder, MachineState* CPU);
+
+
+/*
+ * Write why the run stopped, the recorded cycles oldest first in WriteOut
+ * format, and a snapshot of the registers and PSR. A NULL reason is taken
+ * from CPU -> fault, or "halt" if there was none.
+ */
+void RecorderDump(FlightRecorder* recorder, MachineState* CPU, const char* reason, FILE* output);
+
+
+/*
+ * Release the ring.
+ */
+void RecorderFree(FlightRecorder* recorder);
+
+#endif
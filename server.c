@@ -0,0 +1,385 @@
+/*
+ * server.c: location of main() for the simulation server
+ *
+ * simd loads the OS image once, then forks one worker per core. Every worker
+ * accepts connections on a Unix domain socket and runs jobs on a copy of the
+ * warm machine, so a job pays for a memcpy instead of a process start, a Reset
+ * and the OS load. The kernel hands each connection to an idle worker.
+ *
+ * Protocol, one text line per request:
+ *   RUN <cycle-limit> <on|off> <n>   run a job with n object files, tracing on or off
+ *   PATH <file.obj>                  one of the n objects, read from the server's disk
+ *   IMAGE <bytes>                    one of the n objects, followed by <bytes> raw bytes
+ *   QUIT                             close the connection
+ * The cycle limit is always enforced; there is no "unlimited" value, and
+ * RUN 0 runs no cycles and just reports the machine as loaded.
+ * When tracing is on the trace is streamed back in WriteOut format while the
+ * job runs. Every job ends with one line:
+ *   DONE <halted|fault|limit> <cycles> <PC> <PSR> <R0> ... <R7>
+ * or ERROR <message> if the job could not be started. Whatever the simulator
+ * reports while the job runs (an invalid address, instruction or PC, a
+ * division by zero) comes back on one FAULT <message> line just before DONE.
+ * The job's object lines and images are still read after an error, so the
+ * next command lines up; when that is impossible (a bad RUN line or IMAGE
+ * size) the server closes the connection after the ERROR. A connection that sends nothing, or reads
+ * none of its trace, for IDLE_TIMEOUT seconds is closed so it can't hold a
+ * worker forever.
+ */
+
+#include "loader.h"
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DEFAULT_SOCKET "/tmp/lc4sim.sock"
+#define MAX_WORKERS 256
+#define MAX_IMAGE_BYTES (1 << 20)
+#define LINE_LENGTH 4096
+#define IDLE_TIMEOUT 30
+
+// Machine with the OS image loaded; copied into job before every run
+MachineState warm;
+MachineState job;
+
+// this worker's fusion table, attached to jobs that run with tracing off
+unsigned char* fuseTable;
+
+pid_t workers[MAX_WORKERS];
+int workerCount;
+volatile sig_atomic_t stopping = 0;
+
+// the signal mask from before the supervisor blocked its signals, for workers
+sigset_t workerMask;
+
+//helpers:
+static void stop(int sig) {
+  stopping = 1;
+}
+
+// only there so SIGCHLD interrupts sigsuspend
+static void childExited(int sig) {
+}
+
+// load the count objects that follow a RUN line into job. Every object line
+// and image is read even after an error, so the connection stays in step with
+// the client. Returns -1 after writing ERROR, or -2 if the stream can no
+// longer be followed and the connection has to be closed.
+static int loadObjects(FILE* in, FILE* out, int count) {
+  char line[LINE_LENGTH];
+  char error[LINE_LENGTH] = "";
+  for (int i = 0; i < count; i++) {
+    if (fgets(line, sizeof(line), in) == NULL) {
+      fprintf(out, "ERROR connection closed while reading objects\n");
+      return -2;
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+
+    if (strncmp(line, "PATH ", 5) == 0) {
+      if (error[0] == '\0' && ReadObjectFile(line + 5, &job) == -1) {
+        snprintf(error, sizeof(error), "could not load %s", line + 5);
+      }
+    } else if (strncmp(line, "IMAGE ", 6) == 0) {
+      long size = atol(line + 6);
+      if (size <= 0 || size > MAX_IMAGE_BYTES) {
+        // we can't tell where the image bytes end
+        fprintf(out, "ERROR invalid image size %ld\n", size);
+        return -2;
+      }
+      char* image = malloc(size);
+      if (image == NULL) {
+        fprintf(out, "ERROR could not allocate image\n");
+        return -2;
+      }
+      if (fread(image, 1, size, in) != (size_t) size) {
+        fprintf(out, "ERROR could not read image\n");
+        free(image);
+        return -2;
+      }
+      if (error[0] == '\0') {
+        FILE* stream = fmemopen(image, size, "rb");
+        int result = (stream == NULL) ? -1 : ReadObjectStream(stream, &job);
+        if (stream != NULL) {
+          fclose(stream);
+        }
+        if (result == -1) {
+          snprintf(error, sizeof(error), "invalid object image");
+        }
+      }
+      free(image);
+    } else if (error[0] == '\0') {
+      snprintf(error, sizeof(error), "expected PATH or IMAGE");
+    }
+  }
+  if (error[0] != '\0') {
+    fprintf(out, "ERROR %s\n", error);
+    return -1;
+  }
+  return 0;
+}
+
+// forget what the simulator printed; the worker's stdout is a private temp file
+static void clearMessages(void) {
+  fflush(stdout);
+  if (ftruncate(STDOUT_FILENO, 0) == 0) {
+    lseek(STDOUT_FILENO, 0, SEEK_SET);
+  }
+}
+
+// send what the simulator printed during the job to the client as one line
+static void sendMessages(FILE* out) {
+  char text[LINE_LENGTH];
+  fflush(stdout);
+  ssize_t length = pread(STDOUT_FILENO, text, sizeof(text) - 1, 0);
+  if (length > 0) {
+    text[length] = '\0';
+    for (ssize_t i = 0; i < length; i++) {
+      if (text[i] == '\n' || text[i] == '\r') {
+        text[i] = ' ';
+      }
+    }
+    fprintf(out, "FAULT %s\n", text);
+  }
+  clearMessages();
+}
+
+// run one job described by a RUN line and write its result to out; returns
+// -1 if the connection can't be followed any more and has to be closed
+static int runJob(FILE* in, FILE* out, char* header) {
+  unsigned long limit;
+  char mode[8];
+  int count;
+  if (sscanf(header, "RUN %lu %7s %d", &limit, mode, &count) != 3 || count < 0 ||
+  (strcmp(mode, "on") != 0 && strcmp(mode, "off") != 0)) {
+    // the object lines that follow would be taken for commands
+    fprintf(out, "ERROR usage: RUN <cycle-limit> <on|off> <n>\n");
+    return -1;
+  }
+
+  FILE* trace = (strcmp(mode, "on") == 0) ? out : NULL;
+  memcpy(&job, &warm, sizeof(MachineState));
+  if (trace == NULL && fuseTable != NULL) {
+    memset(fuseTable, 0, 65536);
+    job.fuseTable = fuseTable;
+  }
+  int loaded = loadObjects(in, out, count);
+  if (loaded < 0) {
+    return (loaded == -2) ? -1 : 0;
+  }
+
+  const char* status = "halted";
+  unsigned long cycles = 0;
+  clearMessages();
+  while (job.PC != 0x80FF) {
+    if (cycles >= limit) {
+      status = "limit";
+      break;
+    }
+    // a fused pair would run past the limit
+    if (limit - cycles < 2) {
+      job.fuseTable = NULL;
+    }
+    int result = UpdateMachineState(&job, trace);
+    if (result == -1) {
+      status = "fault";
+      break;
+    }
+    cycles += result;
+    // the client stopped reading, so every further write would wait out the timeout
+    if (trace != NULL && ferror(trace)) {
+      return -1;
+    }
+  }
+
+  sendMessages(out);
+  fprintf(out, "DONE %s %lu %04X %04X", status, cycles, job.PC, job.PSR);
+  for (int i = 0; i < 8; i++) {
+    fprintf(out, " %04X", job.R[i]);
+  }
+  fprintf(out, "\n");
+  return 0;
+}
+
+// worker loop: accept connections and run their jobs until killed
+static void serve(int listener) {
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGCHLD, SIG_DFL);
+  sigprocmask(SIG_SETMASK, &workerMask, NULL);
+  // the simulator prints faults to stdout; collect them for the client instead
+  FILE* messages = tmpfile();
+  if (messages != NULL) {
+    fflush(stdout);
+    dup2(fileno(messages), STDOUT_FILENO);
+    fclose(messages);
+  }
+  if (EnableFusion(&job) == 0) {
+    fuseTable = job.fuseTable;
+  }
+  while (1) {
+    int conn = accept(listener, NULL, NULL);
+    if (conn < 0) {
+      continue;
+    }
+    // reads and writes that stall this long fail, which closes the connection
+    struct timeval idle = { IDLE_TIMEOUT, 0 };
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+    setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &idle, sizeof(idle));
+    FILE* in = fdopen(conn, "r");
+    FILE* out = fdopen(dup(conn), "w");
+    if (in == NULL || out == NULL) {
+      close(conn);
+      continue;
+    }
+
+    char line[LINE_LENGTH];
+    while (fgets(line, sizeof(line), in) != NULL) {
+      if (strncmp(line, "RUN ", 4) == 0) {
+        if (runJob(in, out, line) == -1) {
+          break;
+        }
+      } else if (strncmp(line, "QUIT", 4) == 0) {
+        break;
+      } else {
+        fprintf(out, "ERROR unknown command\n");
+      }
+      fflush(out);
+    }
+    fclose(in);
+    fclose(out);
+  }
+}
+
+static pid_t startWorker(int listener) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    serve(listener);
+    exit(0);
+  }
+  return pid;
+}
+
+int main(int argc, char** argv) {
+
+  char* socketPath = DEFAULT_SOCKET;
+  workerCount = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:w:")) != -1) {
+    switch (opt) {
+      case 's':
+        socketPath = optarg;
+        break;
+      case 'w':
+        workerCount = atoi(optarg);
+        break;
+      default:
+        printf("usage: simd [-s socket] [-w workers] [os.obj ...]\n");
+        return -1;
+    }
+  }
+  if (workerCount < 1) {
+    workerCount = 1;
+  }
+  if (workerCount > MAX_WORKERS) {
+    workerCount = MAX_WORKERS;
+  }
+
+  // the warm machine is shared copy-on-write by every worker
+  Reset(&warm);
+  for (int i = optind; i < argc; i++) {
+    if (ReadObjectFile(argv[i], &warm) == -1) {
+      printf("could not load %s\n", argv[i]);
+      return -1;
+    }
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+    printf("socket path is too long\n");
+    return -1;
+  }
+  strcpy(addr.sun_path, socketPath);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socketPath);
+  if (listener < 0 || bind(listener, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+  listen(listener, SOMAXCONN) < 0) {
+    printf("could not listen on %s: %s\n", socketPath, strerror(errno));
+    return -1;
+  }
+
+  // the signals stay blocked except inside sigsuspend, so none of them can
+  // arrive between checking stopping and going to sleep
+  sigset_t blocked;
+  sigemptyset(&blocked);
+  sigaddset(&blocked, SIGINT);
+  sigaddset(&blocked, SIGTERM);
+  sigaddset(&blocked, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &blocked, &workerMask);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  action.sa_handler = childExited;
+  sigaction(SIGCHLD, &action, NULL);
+
+  int failed = 0;
+  for (int i = 0; i < workerCount && !failed; i++) {
+    workers[i] = startWorker(listener);
+    if (workers[i] < 0) {
+      printf("could not start workers: %s\n", strerror(errno));
+      failed = 1;
+      stopping = 1;
+    }
+  }
+  if (!failed) {
+    printf("simd: %d workers listening on %s\n", workerCount, socketPath);
+  }
+  fflush(stdout);
+
+  // replace workers that die, or that could not be forked, until we are stopped
+  while (!stopping) {
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+      for (int i = 0; i < workerCount; i++) {
+        if (workers[i] == pid) {
+          workers[i] = -1;
+        }
+      }
+    }
+    int missing = 0;
+    for (int i = 0; i < workerCount; i++) {
+      if (workers[i] < 0) {
+        workers[i] = startWorker(listener);
+        missing |= workers[i] < 0;
+      }
+    }
+    if (missing) {
+      // back off before forking again, with the stop signals let through
+      sigprocmask(SIG_SETMASK, &workerMask, NULL);
+      sleep(1);
+      sigprocmask(SIG_BLOCK, &blocked, NULL);
+    } else {
+      sigsuspend(&workerMask);
+    }
+  }
+
+  for (int i = 0; i < workerCount; i++) {
+    if (workers[i] > 0) {
+      kill(workers[i], SIGTERM);
+    }
+  }
+  while (wait(NULL) > 0) {
+  }
+  close(listener);
+  unlink(socketPath);
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * shard.c: Defines parallel trace generation from snapshots of an untraced run
+ *
+ * The run itself happens once, serially and without tracing, and keeps a
+ * snapshot every interval cycles: the fields of MachineState before memory,
+ * plus the memory pages STR wrote since the snapshot before. The trace is
+ * then cut into one segment per snapshot. Worker w regenerates segments w,
+ * w + workers, w + 2 * workers, ... in order into its own temporary file,
+ * rebuilding memory by replaying page changes forward from the loaded
+ * machine, and the parent copies the segments back into the output in
+ * order. The simulator is deterministic, so every segment is exactly the
+ * bytes the serial run prints for those cycles.
+ */
+
+#include "shard.h"
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define HEADER_SIZE offsetof(MachineState, memory)
+#define PAGES (65536 / SHARD_PAGE_WORDS)
+
+//helpers:
+static int takeSnapshot(ShardedTrace* shard, MachineState* CPU) {
+  if (shard -> count == shard -> capacity) {
+    int capacity = shard -> capacity ? 2 * shard -> capacity : 64;
+    ShardSnapshot* grown = realloc(shard -> snapshots, capacity * sizeof(ShardSnapshot));
+    if (grown == NULL) {
+      printf("could not allocate trace snapshots\n");
+      return -1;
+    }
+    shard -> snapshots = grown;
+    shard -> capacity = capacity;
+  }
+
+  int pageCount = 0;
+  for (int page = 0; page < PAGES; page++) {
+    pageCount += shard -> dirty[page];
+  }
+  ShardSnapshot* snapshot = &shard -> snapshots[shard -> count];
+  snapshot -> cycle = shard -> cycles;
+  snapshot -> pageCount = pageCount;
+  snapshot -> header = malloc(HEADER_SIZE);
+  snapshot -> pages = malloc(pageCount + 1);
+  snapshot -> contents = malloc(pageCount * SHARD_PAGE_WORDS * sizeof(unsigned short) + 1);
+  if (snapshot -> header == NULL || snapshot -> pages == NULL || snapshot -> contents == NULL) {
+    printf("could not allocate trace snapshots\n");
+    free(snapshot -> header);
+    free(snapshot -> pages);
+    free(snapshot -> contents);
+    return -1;
+  }
+
+  memcpy(snapshot -> header, CPU, HEADER_SIZE);
+  int at = 0;
+  for (int page = 0; page < PAGES; page++) {
+    if (shard -> dirty[page]) {
+      snapshot -> pages[at] = page;
+      memcpy(&snapshot -> contents[at * SHARD_PAGE_WORDS], &CPU -> memory[page * SHARD_PAGE_WORDS],
+        SHARD_PAGE_WORDS * sizeof(unsigned short));
+      shard -> dirty[page] = 0;
+      at++;
+    }
+  }
+  shard -> count++;
+  return 0;
+}
+
+static void applyPages(MachineState* machine, ShardSnapshot* snapshot) {
+  for (int i = 0; i < snapshot -> pageCount; i++) {
+    memcpy(&machine -> memory[snapshot -> pages[i] * SHARD_PAGE_WORDS], &snapshot -> contents[i * SHARD_PAGE_WORDS],
+      SHARD_PAGE_WORDS * sizeof(unsigned short));
+  }
+}
+
+// regenerate segments worker, worker + workers, ... into part and record their sizes
+static int writeSegments(ShardedTrace* shard, int worker, int workers, FILE* part, unsigned long long* sizes) {
+  MachineState* machine = malloc(sizeof(MachineState));
+  if (machine == NULL) {
+    return -1;
+  }
+  memcpy(machine, shard -> base, sizeof(MachineState));
+
+  int applied = 0;
+  for (int i = worker; i < shard -> count; i += workers) {
+    // memory already holds the writes of the segment before i - workers + 1
+    for (; applied <= i; applied++) {
+      applyPages(machine, &shard -> snapshots[applied]);
+    }
+    memcpy(machine, shard -> snapshots[i].header, HEADER_SIZE);
+    machine -> icache = NULL;
+    machine -> dcache = NULL;
+    machine -> fuseTable = NULL;
+    machine -> recorder = NULL;
+    machine -> keyboard = NULL;
+
+    unsigned long long end = (i + 1 < shard -> count) ? shard -> snapshots[i + 1].cycle : shard -> cycles;
+    off_t start = ftello(part);
+    for (unsigned long long cycle = shard -> snapshots[i].cycle; cycle < end; cycle++) {
+      if (UpdateMachineState(machine, part) == -1) {
+        break;
+      }
+    }
+    sizes[i] = ftello(part) - start;
+  }
+  free(machine);
+  return ferror(part) ? -1 : 0;
+}
+
+static int copyBytes(FILE* from, FILE* to, unsigned long long count) {
+  char buffer[65536];
+  while (count > 0) {
+    size_t chunk = (count < sizeof(buffer)) ? count : sizeof(buffer);
+    if (fread(buffer, 1, chunk, from) != chunk || fwrite(buffer, 1, chunk, to) != chunk) {
+      return -1;
+    }
+    count -= chunk;
+  }
+  return 0;
+}
+
+/*
+ * Keep a copy of the loaded machine and take the first snapshot.
+ */
+int ShardInit(ShardedTrace* shard, MachineState* CPU, unsigned long long interval)
+{
+  memset(shard, 0, sizeof(ShardedTrace));
+  if (interval < 1) {
+    printf("snapshot interval must be at least 1 cycle\n");
+    return -1;
+  }
+  shard -> interval = interval;
+  shard -> nextSnapshot = interval;
+  shard -> base = malloc(sizeof(MachineState));
+  if (shard -> base == NULL) {
+    printf("could not allocate trace snapshots\n");
+    return -1;
+  }
+  memcpy(shard -> base, CPU, sizeof(MachineState));
+  return takeSnapshot(shard, CPU);
+}
+
+/*
+ * Note the page STR wrote, if insn was a store, and snapshot every interval cycles.
+ */
+int ShardStep(ShardedTrace* shard, MachineState* CPU, unsigned short insn)
+{
+  if ((insn >> 12) == 7) {
+    shard -> dirty[CPU -> dmemAddr / SHARD_PAGE_WORDS] = 1;
+  }
+  shard -> cycles++;
+  if (shard -> cycles == shard -> nextSnapshot) {
+    shard -> nextSnapshot += shard -> interval;
+    return takeSnapshot(shard, CPU);
+  }
+  return 0;
+}
+
+/*
+ * Fork the workers, wait for all of them, then stitch their segments into output.
+ */
+int ShardWrite(ShardedTrace* shard, FILE* output, int workers)
+{
+  if (workers > shard -> count) {
+    workers = shard -> count;
+  }
+  if (workers < 1) {
+    workers = 1;
+  }
+
+  // written by the workers, read by the parent
+  unsigned long long* sizes = mmap(NULL, shard -> count * sizeof(unsigned long long), PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  FILE** parts = calloc(workers, sizeof(FILE*));
+  pid_t* pids = calloc(workers, sizeof(pid_t));
+  int result = 0;
+  if (sizes == MAP_FAILED || parts == NULL || pids == NULL) {
+    printf("could not allocate trace workers\n");
+    result = -1;
+  }
+  for (int w = 0; w < workers && result == 0; w++) {
+    parts[w] = tmpfile();
+    if (parts[w] == NULL) {
+      printf("could not create a temporary trace file\n");
+      result = -1;
+    }
+  }
+
+  // nothing buffered may be written twice by the children
+  fflush(stdout);
+  fflush(output);
+  for (int w = 0; w < workers && result == 0; w++) {
+    pids[w] = fork();
+    if (pids[w] == 0) {
+      // the serial run already printed any fault messages
+      if (freopen("/dev/null", "w", stdout) == NULL) {
+        _exit(1);
+      }
+      int status = writeSegments(shard, w, workers, parts[w], sizes);
+      status |= fclose(parts[w]);
+      _exit(status == 0 ? 0 : 1);
+    }
+    if (pids[w] < 0) {
+      printf("could not start trace worker\n");
+      result = -1;
+    }
+  }
+  for (int w = 0; w < workers && pids != NULL; w++) {
+    int status;
+    if (pids[w] > 0 && (waitpid(pids[w], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+      printf("trace worker %d failed\n", w);
+      result = -1;
+    }
+  }
+
+  for (int w = 0; w < workers && result == 0; w++) {
+    rewind(parts[w]);
+  }
+  for (int i = 0; i < shard -> count && result == 0; i++) {
+    if (copyBytes(parts[i % workers], output, sizes[i]) == -1) {
+      printf("could not copy trace segment %d\n", i);
+      result = -1;
+    }
+  }
+
+  for (int w = 0; w < workers && parts != NULL; w++) {
+    if (parts[w] != NULL) {
+      fclose(parts[w]);
+    }
+  }
+  if (sizes != MAP_FAILED) {
+    munmap(sizes, shard -> count * sizeof(unsigned long long));
+  }
+  free(parts);
+  free(pids);
+  return result;
+}
+
+/*
+ * Release the snapshots and the copy of the loaded machine.
+ */
+void ShardFree(ShardedTrace* shard)
+{
+  for (int i = 0; i < shard -> count; i++) {
+    free(shard -> snapshots[i].header);
+    free(shard -> snapshots[i].pages);
+    free(shard -> snapshots[i].contents);
+  }
+  free(shard -> snapshots);
+  free(shard -> base);
+  memset(shard, 0, sizeof(ShardedTrace));
+}
@@ -0,0 +1,71 @@
+/*
+ * shard.h: Declares parallel trace generation from snapshots of an untraced run
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "LC4.h"
+
+#define SHARD_PAGE_WORDS 256
+
+// The machine after a given number of cycles, as a change to the snapshot before it
+typedef struct {
+    // instructions retired before this snapshot
+    unsigned long long cycle;
+
+    // registers, PSR and control signals: the MachineState fields before memory
+    unsigned char* header;
+
+    // memory pages written since the previous snapshot and their contents
+    int pageCount;
+    unsigned char* pages;
+    unsigned short* contents;
+} ShardSnapshot;
+
+typedef struct {
+    // cycles between snapshots
+    unsigned long long interval;
+    unsigned long long cycles;
+    unsigned long long nextSnapshot;
+
+    // the machine as loaded, which the first snapshot starts from
+    MachineState* base;
+
+    ShardSnapshot* snapshots;
+    int count;
+    int capacity;
+
+    // pages written since the last snapshot
+    unsigned char dirty[65536 / SHARD_PAGE_WORDS];
+} ShardedTrace;
+
+
+/*
+ * Start recording snapshots of CPU every interval cycles. Call this after the
+ * object files are loaded. Returns -1 on failure.
+ */
+int ShardInit(ShardedTrace* shard, MachineState* CPU, unsigned long long interval);
+
+
+/*
+ * Account for one instruction UpdateMachineState retired without tracing.
+ * insn is the instruction it ran. Returns -1 if a snapshot could not be stored.
+ */
+int ShardStep(ShardedTrace* shard, MachineState* CPU, unsigned short insn);
+
+
+/*
+ * Regenerate the trace of every segment between snapshots on workers
+ * processes and write them to output in order, byte for byte what a traced
+ * serial run would have written. Returns -1 on failure.
+ */
+int ShardWrite(ShardedTrace* shard, FILE* output, int workers);
+
+
+/*
+ * Release the snapshots.
+ */
+void ShardFree(ShardedTrace* shard);
+
+#endif
@@ -0,0 +1,90 @@
+# testing script for the built-in assembler
+# make sure this script is in your main working directory
+# (with your .c files etc), build with make and run:
+# ./test_asm.sh
+# if you get permission denied, run
+# chmod +x test_asm.sh
+# and try again
+#
+# every p2_test_cases/*.asm is assembled with ./trace -a and the memory
+# image it loads is compared with the one PennSim's .obj loads. Sections
+# and symbols may come in a different order, so both files are decoded
+# into sorted "code|data|symbol address value" lines first.
+
+# function for printing result
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m'
+BOLD='\033[1m'
+NORMAL='\033[0m'
+
+function result() {
+    if [ $1 = "Success" ]; then
+        printf "${GREEN}${BOLD}Success${NC}${NORMAL}\n"
+    fi
+    if [ $1 = "Failure" ]; then
+        printf "${RED}${BOLD}Failure${NC}${NORMAL}\n"
+    fi
+}
+
+# function to print the words and symbols an object file loads, one per line
+function image() {
+    od -An -v -tx1 $1 | awk '
+    { for (i = 1; i <= NF; i++) bytes[n++] = $i }
+    function word(at) { return bytes[at] bytes[at + 1] }
+    function hex(text,    value, i) {
+        value = 0
+        for (i = 1; i <= length(text); i++) {
+            value = value * 16 + index("0123456789abcdef", substr(text, i, 1)) - 1
+        }
+        return value
+    }
+    END {
+        at = 0
+        while (at < n) {
+            header = word(at)
+            if (header == "cade" || header == "dada") {
+                kind = (header == "cade") ? "code" : "data"
+                address = hex(word(at + 2))
+                count = hex(word(at + 4))
+                for (i = 0; i < count; i++) {
+                    printf "%s %04x %s\n", kind, (address + i) % 65536, word(at + 6 + 2 * i)
+                }
+                at += 6 + 2 * count
+            } else if (header == "c3b7") {
+                count = hex(word(at + 4))
+                name = ""
+                for (i = 0; i < count; i++) {
+                    name = name bytes[at + 6 + i]
+                }
+                printf "symbol %s %s\n", word(at + 2), name
+                at += 6 + count
+            } else if (header == "f17e") {
+                at += 4 + hex(word(at + 2))
+            } else if (header == "715e") {
+                at += 8
+            } else {
+                printf "bad header %s at byte %d\n", header, at
+                exit
+            }
+        }
+    }' | sort
+}
+
+echo "--------------------------------------------"
+for asm in p2_test_cases/*.asm
+do
+    obj=${asm%.asm}.obj
+    echo $(basename $asm)
+    success="Failure"
+    if ./trace -a /tmp/test_asm.obj $asm > /dev/null; then
+        if [ "$(image $obj)" = "$(image /tmp/test_asm.obj)" ]; then
+            success="Success"
+        fi
+    fi
+    result $success
+    echo "--------------------------------------------"
+done
+
+# clean up
+rm -f /tmp/test_asm.obj
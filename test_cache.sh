@@ -0,0 +1,66 @@
+# testing script for the cache model (trace -i and -d)
+# make sure this script is in your main working directory
+# (with your .c files etc), build with make and run:
+# ./test_cache.sh
+# if you get permission denied, run
+# chmod +x test_cache.sh
+# and try again
+#
+# runs programs that stop under several cache geometries and policies and
+# compares the report's totals: accesses, hits, misses, and for the data
+# cache writebacks and memory writes. The random policy uses a fixed seed.
+
+# function for printing result
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m'
+BOLD='\033[1m'
+NORMAL='\033[0m'
+
+function result() {
+    if [ $1 = "Success" ]; then
+        printf "${GREEN}${BOLD}Success${NC}${NORMAL}\n"
+    fi
+    if [ $1 = "Failure" ]; then
+        printf "${RED}${BOLD}Failure${NC}${NORMAL}\n"
+    fi
+}
+
+# function to print the totals of one cache report on a single line
+# usage: totals <-i|-d> <cache-config> <file.obj|file.asm>
+function totals() {
+    timeout 10 ./trace -n $1 $2 p2_test_cases/os.obj $3 2> /dev/null | awk '
+    $1 == "accesses" || $1 == "hits" || $1 == "misses" || $1 == "writebacks" { line = line " " $2 }
+    $1 == "memory" { line = line " " $3 }
+    END { print substr(line, 2) }'
+}
+
+# cache, config, program, expected totals
+cases=(
+    "-i size=32,assoc=1,block=4 test_loops.asm 1765 1709 56"
+    "-d size=8,assoc=2,block=2 test_loops.asm 361 286 75 37 0"
+    "-d size=8,assoc=2,block=2,write=wt test_loops.asm 361 286 75 0 121"
+    "-d size=8,assoc=4,block=1,repl=random test_loops.asm 361 255 106 81 0"
+    "-d size=16,assoc=2,block=2 test_loops.asm 361 355 6 0 0"
+    "-d size=8,assoc=2,block=2 p1_test_cases/sum.obj 1 0 1 0 0"
+)
+
+echo "--------------------------------------------"
+for case in "${cases[@]}"
+do
+    set -- $case
+    cache=$1
+    config=$2
+    program=$3
+    shift 3
+    echo "$program with $cache $config"
+    got=$(totals $cache $config $program)
+    if [ "$got" = "$*" ]; then
+        result "Success"
+    else
+        echo "expected: $*"
+        echo "got:      $got"
+        result "Failure"
+    fi
+    echo "--------------------------------------------"
+done
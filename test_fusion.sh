@@ -0,0 +1,117 @@
+# testing script for instruction fusion
+# make sure this script is in your main working directory
+# (with your .c files etc), build with make and run:
+# ./test_fusion.sh
+# if you get permission denied, run
+# chmod +x test_fusion.sh
+# and try again
+#
+# simd fuses instruction pairs only when tracing is off, so every test
+# program is run with RUN ... off and RUN ... on under the same cycle limit
+# and the DONE lines (status, cycles, PC, PSR and registers) have to match.
+# The limit stops programs that never halt at the same cycle in both runs.
+# The test programs don't use every pair, so a small program that does, and
+# that ends on a pair whose second word is the halt address, is run as well.
+
+limit=50000
+
+# function for printing result
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m'
+BOLD='\033[1m'
+NORMAL='\033[0m'
+
+function result() {
+    if [ $1 = "Success" ]; then
+        printf "${GREEN}${BOLD}Success${NC}${NORMAL}\n"
+    fi
+    if [ $1 = "Failure" ]; then
+        printf "${RED}${BOLD}Failure${NC}${NORMAL}\n"
+    fi
+}
+
+# function to run one object on simd and print the line that ends the job
+# usage: done_line <socket> <cycle-limit> <on|off> <file.obj>
+function done_line() {
+    python3 - "$@" <<'EOF'
+import socket, sys
+path, limit, mode, obj = sys.argv[1:]
+conn = socket.socket(socket.AF_UNIX)
+conn.connect(path)
+conn.sendall(("RUN %s %s 1\nPATH %s\nQUIT\n" % (limit, mode, obj)).encode())
+reply = b""
+while True:
+    chunk = conn.recv(65536)
+    if not chunk:
+        break
+    reply += chunk
+for line in reply.decode(errors="replace").splitlines():
+    if line.startswith("DONE") or line.startswith("ERROR"):
+        print(line)
+EOF
+}
+
+work=$(mktemp -d)
+trap 'kill $server 2> /dev/null; rm -rf $work' EXIT
+
+cat > $work/pairs.asm <<'END'
+        .CODE
+        .ADDR x0000
+        CONST R2, #64
+        CONST R3, #128
+        MUL R2, R2, R3          ; R2 = x2000
+        CONST R4, #3
+        CONST R7, #1
+LOOP    LDR R1, R2, #0          ; LDR + ADD
+        ADD R5, R5, R1
+        CONST R6, #-2           ; CONST + HICONST
+        HICONST R6, #1
+        SUB R4, R4, R7
+        CMPI R4, #0             ; CMP + BR
+        BRp LOOP
+        TRAP x7E
+
+        .DATA
+        .ADDR x2000
+        .FILL #7
+
+        .OS
+        .CODE
+        .ADDR x807E
+        JMP LAST
+        .ADDR x80FE
+LAST    CMPI R5, #0             ; CMP + the NOP at the halt address
+        NOP
+END
+./trace -a $work/pairs.obj $work/pairs.asm > /dev/null
+
+echo "--------------------------------------------"
+for os in p1_test_cases/os.obj p2_test_cases/os.obj
+do
+    ./simd -s $work/simd.sock -w 2 $os > /dev/null &
+    server=$!
+    while [ ! -S $work/simd.sock ]; do sleep 0.1; done
+
+    for obj in p1_test_cases/*.obj p2_test_cases/*.obj $work/pairs.obj
+    do
+        if [ $(basename $obj) = "os.obj" ]; then
+            continue
+        fi
+        echo "$(basename $obj) with $os"
+        fused=$(done_line $work/simd.sock $limit off $obj)
+        stepped=$(done_line $work/simd.sock $limit on $obj)
+        if [ "${fused:0:4}" = "DONE" ] && [ "$fused" = "$stepped" ]; then
+            result "Success"
+        else
+            echo "fused:   $fused"
+            echo "unfused: $stepped"
+            result "Failure"
+        fi
+        echo "--------------------------------------------"
+    done
+
+    kill $server
+    wait $server 2> /dev/null
+    rm -f $work/simd.sock
+done
@@ -0,0 +1,102 @@
+# testing script for the fuzzer (fuzz)
+# make sure this script is in your main working directory
+# (with your .c files etc), build with make and run:
+# ./test_fuzz.sh
+# if you get permission denied, run
+# chmod +x test_fuzz.sh
+# and try again
+#
+# fuzzes a small OS program whose paths depend on four words at xFF00 for a
+# couple of seconds with one worker. The program has 14 edges, 6 ways to
+# reach them, one faulting load and one endless loop, so a short run finds
+# all of them whatever the random seed was. The saved inputs are then
+# replayed, which is deterministic, and have to end the same way again.
+
+# function for printing result
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m'
+BOLD='\033[1m'
+NORMAL='\033[0m'
+
+function result() {
+    if [ $1 = "Success" ]; then
+        printf "${GREEN}${BOLD}Success${NC}${NORMAL}\n"
+    fi
+    if [ $1 = "Failure" ]; then
+        printf "${RED}${BOLD}Failure${NC}${NORMAL}\n"
+    fi
+}
+
+# function to compare output with what was expected
+# usage: check <name> <expected> <got>
+function check() {
+    echo "$1"
+    if [ "$2" = "$3" ]; then
+        result "Success"
+    else
+        echo "expected:"
+        echo "$2"
+        echo "got:"
+        echo "$3"
+        result "Failure"
+    fi
+    echo "--------------------------------------------"
+}
+
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+
+cat > $work/target.asm <<'END'
+        .OS
+        .CODE
+        .ADDR x80FF
+HALT    NOP
+        .ADDR x8200
+        CONST R0, #-256         ; xFF00
+        LDR R1, R0, #0
+        BRz ZERO
+        BRn NEG
+        LDR R2, R0, #1
+        BRn POSNEG
+        NOT R3, R2
+        LDR R4, R3, #0          ; faults when ~R2 is not an OS data address
+        JMP HALT
+POSNEG  LDR R2, R0, #2
+        BRz ZERO
+LOOP    BRnzp LOOP              ; hangs
+ZERO    JMP HALT
+NEG     LDR R5, R0, #3
+        BRp ZERO
+        JMP HALT
+END
+
+echo "--------------------------------------------"
+timeout 30 ./fuzz -m xFF00:4 -l 1000 -w 1 -t 2 -o $work/out $work/target.asm > $work/summary.txt 2> /dev/null
+status=$?
+check "fuzzing for 2 seconds" \
+"14 edges, 6 queued, 1 faults, 1 hangs
+exit status 0" \
+"$(sed 's/.*workers, \(.*\) in .*/\1/' $work/summary.txt)
+exit status $status"
+
+check "saved inputs" \
+"faults/w00-000000
+hangs/w00-000000
+6" \
+"$(cd $work/out && ls faults/* hangs/*; ls queue | wc -l)"
+
+check "replaying the fault" \
+"Invalid memory address
+fault after 7 cycles at PC 8207, 3 edges" \
+"$(timeout 10 ./fuzz -r $work/out/faults/w00-000000 -m xFF00:4 -l 1000 $work/target.asm | grep .)"
+
+check "replaying the hang" \
+"limit after 1000 cycles at PC 820B, 5 edges" \
+"$(timeout 10 ./fuzz -r $work/out/hangs/w00-000000 -m xFF00:4 -l 1000 $work/target.asm | grep .)"
+
+# all zero words take the BRz straight to HALT
+printf '\0\0\0\0\0\0\0\0' > $work/zeros
+check "replaying zero words" \
+"halted after 4 cycles at PC 820C, 2 edges" \
+"$(timeout 10 ./fuzz -r $work/zeros -m xFF00:4 -l 1000 $work/target.asm | grep .)"
@@ -0,0 +1,46 @@
+; test program for the smoke tests (test_pipeline.sh, test_cache.sh, test_profiler.sh):
+; nested loops over a 10 word array, a branch taken every other time, and
+; a subroutine called once per outer loop. Halts through TRAP x7E.
+
+        .CODE
+        .ADDR x0000
+        CONST R0, #1
+        CONST R2, #128
+        CONST R3, #128
+        MUL R2, R2, R3          ; R2 = x4000, a 10 word array
+        CONST R4, #12
+OUTER   CONST R1, #0
+        ADD R1, R1, R2
+        CONST R5, #10
+INNER   LDR R3, R1, #0          ; array[i] += count
+        ADD R3, R3, R5
+        STR R3, R1, #0
+        ADD R1, R1, R0
+        AND R3, R5, R0          ; taken every other time
+        BRz EVEN
+        ADD R6, R6, R0
+EVEN    SUB R5, R5, R0
+        BRp INNER
+        JSR SUM
+        SUB R4, R4, R0
+        BRp OUTER
+        TRAP x7E
+
+        .FALIGN
+SUM     CONST R6, #0            ; R6 = sum of the array
+        CONST R1, #0
+        ADD R1, R1, R2
+        CONST R3, #10
+SLOOP   LDR R5, R1, #0
+        ADD R6, R6, R5
+        ADD R1, R1, R0
+        SUB R3, R3, R0
+        BRp SLOOP
+        RET
+
+        .OS
+        .CODE
+        .ADDR x807E
+        JMP HALT
+        .ADDR x80FF
+HALT    NOP
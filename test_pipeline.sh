@@ -0,0 +1,68 @@
+# testing script for the pipeline timing model (trace -p)
+# make sure this script is in your main working directory
+# (with your .c files etc), build with make and run:
+# ./test_pipeline.sh
+# if you get permission denied, run
+# chmod +x test_pipeline.sh
+# and try again
+#
+# runs programs that stop under every predictor and compares the report's
+# totals: instructions, cycles, branches, mispredicted branches, and the
+# load-use, branch and jump stall cycles.
+
+# function for printing result
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m'
+BOLD='\033[1m'
+NORMAL='\033[0m'
+
+function result() {
+    if [ $1 = "Success" ]; then
+        printf "${GREEN}${BOLD}Success${NC}${NORMAL}\n"
+    fi
+    if [ $1 = "Failure" ]; then
+        printf "${RED}${BOLD}Failure${NC}${NORMAL}\n"
+    fi
+}
+
+# function to print the totals of one -p report on a single line
+# usage: totals <predictor> <file.obj|file.asm>
+function totals() {
+    timeout 10 ./trace -n -p $1 p2_test_cases/os.obj $2 2> /dev/null | awk '
+    $1 == "instructions" { insns = $2 }
+    $1 == "cycles" { cycles = $2 }
+    $1 == "branches" { branches = $2; mispredicted = $4 }
+    $1 == "load-use" || $1 == "branch" || $1 == "jump" { stalls = stalls " " $3 }
+    END { gsub(/[,(]/, "", branches); gsub(/[(]/, "", stalls); print insns, cycles, branches, mispredicted stalls }'
+}
+
+# predictor, program, expected totals
+cases=(
+    "not-taken p1_test_cases/sum.obj 13 23 1 1 0 2 4"
+    "gshare p1_test_cases/sum.obj 13 23 1 1 0 2 4"
+    "bimodal p1_test_cases/user_square.obj 13 23 0 0 0 0 6"
+    "not-taken p2_test_cases/triangle.obj 13 23 1 1 0 2 4"
+    "not-taken test_loops.asm 1765 2637 372 287 240 574 54"
+    "bimodal test_loops.asm 1765 2583 372 148 240 520 54"
+    "gshare:4 test_loops.asm 1765 2410 372 35 240 347 54"
+)
+
+echo "--------------------------------------------"
+for case in "${cases[@]}"
+do
+    set -- $case
+    predictor=$1
+    program=$2
+    shift 2
+    echo "$program with -p $predictor"
+    got=$(totals $predictor $program)
+    if [ "$got" = "$*" ]; then
+        result "Success"
+    else
+        echo "expected: $*"
+        echo "got:      $got"
+        result "Failure"
+    fi
+    echo "--------------------------------------------"
+done
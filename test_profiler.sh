@@ -0,0 +1,76 @@
+# testing script for the call-graph profiler (trace -g)
+# make sure this script is in your main working directory
+# (with your .c files etc), build with make and run:
+# ./test_profiler.sh
+# if you get permission denied, run
+# chmod +x test_profiler.sh
+# and try again
+#
+# runs programs that stop and compares the folded stacks written by -g,
+# and for test_loops.asm the calls, inclusive and exclusive counts of the
+# routines in the report.
+
+# function for printing result
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m'
+BOLD='\033[1m'
+NORMAL='\033[0m'
+
+function result() {
+    if [ $1 = "Success" ]; then
+        printf "${GREEN}${BOLD}Success${NC}${NORMAL}\n"
+    fi
+    if [ $1 = "Failure" ]; then
+        printf "${RED}${BOLD}Failure${NC}${NORMAL}\n"
+    fi
+}
+
+# function to compare output with what was expected
+# usage: check <name> <expected> <got>
+function check() {
+    echo "$1"
+    if [ "$2" = "$3" ]; then
+        result "Success"
+    else
+        echo "expected:"
+        echo "$2"
+        echo "got:"
+        echo "$3"
+        result "Failure"
+    fi
+    echo "--------------------------------------------"
+}
+
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+
+echo "--------------------------------------------"
+timeout 10 ./trace -n -g $work/folded.txt p1_test_cases/os.obj p1_test_cases/user_square.obj > /dev/null
+check "folded stacks of user_square.obj" \
+"OS_START 6
+x0000 6
+x0000;TRAP_x02 1" \
+"$(cat $work/folded.txt)"
+
+timeout 10 ./trace -n -g $work/folded.txt p1_test_cases/os.obj p1_test_cases/sum.obj > /dev/null
+check "folded stacks of sum.obj, which faults" \
+"OS_START 6
+INIT 7" \
+"$(cat $work/folded.txt)"
+
+# the report rows are entry, calls, inclusive, %, exclusive, %, name
+timeout 10 ./trace -n -g $work/folded.txt p2_test_cases/os.obj test_loops.asm > $work/report.txt
+check "folded stacks of test_loops.asm" \
+"OS_START 6
+x0000 1098
+x0000;SUM 660
+x0000;TRAP_x7E 1" \
+"$(cat $work/folded.txt)"
+
+check "routines in the report for test_loops.asm" \
+"0000 1 1759 1098 x0000
+0020 12 660 660 SUM
+8200 1 6 6 OS_START
+807E 1 1 1 TRAP_x7E" \
+"$(awk 'NF == 7 && $1 ~ /^[0-9A-F][0-9A-F][0-9A-F][0-9A-F]$/ { print $1, $2, $3, $5, $7 }' $work/report.txt)"
@@ -0,0 +1,105 @@
+# testing script for the flight recorder (trace -f)
+# make sure this script is in your main working directory
+# (with your .c files etc), build with make and run:
+# ./test_recorder.sh
+# if you get permission denied, run
+# chmod +x test_recorder.sh
+# and try again
+#
+# runs programs that fault, crash the simulator or get interrupted, and
+# compares the dump written to stderr; it has to end with the cycle that
+# faulted. The trace written next to the recorder must not change.
+
+# function for printing result
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m'
+BOLD='\033[1m'
+NORMAL='\033[0m'
+
+function result() {
+    if [ $1 = "Success" ]; then
+        printf "${GREEN}${BOLD}Success${NC}${NORMAL}\n"
+    fi
+    if [ $1 = "Failure" ]; then
+        printf "${RED}${BOLD}Failure${NC}${NORMAL}\n"
+    fi
+}
+
+# function to compare a dump with what was expected; trace lines end in a
+# space, which is dropped before comparing
+# usage: check <name> <expected> <got>
+function check() {
+    echo "$1"
+    if [ "$2" = "$(echo "$3" | sed 's/ *$//')" ]; then
+        result "Success"
+    else
+        echo "expected:"
+        echo "$2"
+        echo "got:"
+        echo "$3"
+        result "Failure"
+    fi
+    echo "--------------------------------------------"
+}
+
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+
+# DIV by a zero register raises SIGFPE inside the simulator
+cat > $work/divide.asm <<'END'
+        .CODE
+        .ADDR x0000
+        CONST R1, #5
+        CONST R2, #0
+        DIV R3, R1, R2
+END
+
+echo "--------------------------------------------"
+check "LDR fault in sum.obj" \
+"# flight recorder: Invalid memory address after 14 cycles, last 4 follow
+0004 1100100000000100 1 4 0005 1 1 1 FFFE 00C8
+0009 0010010100000000 1 2 0005 1 1 1 FFFE 00C8
+000A 0000001111111010 0 0 0000 0 0 0 0000 0000
+0005 0110011000000000 1 3 0000 1 1 0 0000 0000
+# Invalid memory address on the cycle above
+# PC=0005 PSR=0001 (user, --P)
+# R0=0040 R1=0000 R2=0005 R3=0000 R4=0000 R5=0000 R6=0000 R7=0000" \
+"$(./trace -n -f 4 p1_test_cases/os.obj p1_test_cases/sum.obj 2>&1 > /dev/null)"
+
+check "STR fault in easy3.obj, tracing to a file" \
+"# flight recorder: Invalid memory address after 10 cycles, last 3 follow
+0001 1001101000000001 1 5 0001 1 1 1 FFFE 00C8
+0002 1101101101000000 1 5 0041 1 1 1 FFFE 00C8
+0003 0111101000000000 1 5 0041 1 1 1 00C8 00C8
+# Invalid memory address on the cycle above
+# PC=0003 PSR=0001 (user, --P)
+# R0=00C8 R1=FFFE R2=0000 R3=0000 R4=0000 R5=0041 R6=0000 R7=0000" \
+"$(./trace -f 3 $work/recorded.txt p1_test_cases/os.obj p1_test_cases/easy3.obj 2>&1 > /dev/null)"
+
+./trace $work/plain.txt p1_test_cases/os.obj p1_test_cases/easy3.obj > /dev/null
+check "trace unchanged by -f" "" "$(diff $work/plain.txt $work/recorded.txt)"
+
+dump=$(./trace -n -f 2 p1_test_cases/os.obj $work/divide.asm 2>&1 > /dev/null)
+status=$?
+check "SIGFPE from DIV" \
+"# flight recorder: signal 8 after 8 cycles, last 2 follow
+0000 1001001000000101 1 1 0005 1 1 1 FFFE 00C8
+0001 1001010000000000 1 2 0000 1 2 1 FFFE 00C8
+# PC=0002 PSR=0002 (user, -Z-)
+# R0=00C8 R1=0005 R2=0000 R3=0000 R4=0000 R5=0000 R6=0000 R7=0000
+exit status 136" \
+"$dump
+exit status $status"
+
+# easy.obj never stops; the dump is written by the main loop after SIGINT
+./trace -n -f 1 p1_test_cases/os.obj p1_test_cases/easy.obj 2> $work/interrupted.txt > /dev/null &
+sleep 0.5
+kill -INT $!
+wait $!
+status=$?
+check "SIGINT" \
+"# flight recorder: signal 2
+exit status 130" \
+"$(head -1 $work/interrupted.txt | cut -d' ' -f1-5)
+exit status $status"
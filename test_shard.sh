@@ -0,0 +1,81 @@
+# testing script for parallel trace generation (trace -j)
+# make sure this script is in your main working directory
+# (with your .c files etc), build with make and run:
+# ./test_shard.sh
+# if you get permission denied, run
+# chmod +x test_shard.sh
+# and try again
+#
+# every test program is traced serially and then with several -j/-k
+# settings, and the files have to be byte for byte the same. Programs that
+# don't stop within the time limit can't be compared and are skipped, and
+# listed at the end; programs that fault are compared up to the fault. A
+# sharded run that doesn't finish when the serial one did is a failure.
+
+# worker counts and snapshot intervals to try
+settings=("-j 1 -k 1000" "-j 2 -k 1" "-j 3 -k 7" "-j 4 -k 64" "-j 16 -k 1000000")
+
+# function for printing result
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[0;33m'
+NC='\033[0m'
+BOLD='\033[1m'
+NORMAL='\033[0m'
+
+function result() {
+    if [ $1 = "Success" ]; then
+        printf "${GREEN}${BOLD}Success${NC}${NORMAL}\n"
+    fi
+    if [ $1 = "Failure" ]; then
+        printf "${RED}${BOLD}Failure${NC}${NORMAL}\n"
+    fi
+    if [ $1 = "Skipped" ]; then
+        printf "${YELLOW}${BOLD}Skipped (does not stop)${NC}${NORMAL}\n"
+    fi
+}
+
+# keep runaway traces from filling the disk
+ulimit -f 1000000
+
+work=$(mktemp -d)
+trap 'rm -rf $work' EXIT
+skipped=()
+
+echo "--------------------------------------------"
+for os in p1_test_cases/os.obj p2_test_cases/os.obj
+do
+    for obj in p1_test_cases/*.obj p2_test_cases/*.obj
+    do
+        if [ $(basename $obj) = "os.obj" ]; then
+            continue
+        fi
+        echo "$(basename $obj) with $os"
+        timeout 5 ./trace $work/serial.txt $os $obj > /dev/null 2>&1
+        if [ $? = 124 ]; then
+            result "Skipped"
+            skipped+=("$(basename $obj) with $os")
+        else
+            success="Success"
+            for setting in "${settings[@]}"
+            do
+                timeout 60 ./trace $setting $work/sharded.txt $os $obj > /dev/null 2>&1
+                if [ $? = 124 ]; then
+                    echo "timed out with $setting"
+                    success="Failure"
+                elif ! cmp -s $work/serial.txt $work/sharded.txt; then
+                    echo "differs with $setting"
+                    success="Failure"
+                fi
+            done
+            result $success
+        fi
+        echo "--------------------------------------------"
+    done
+done
+
+echo "skipped ${#skipped[@]} programs that don't stop within 5 seconds:"
+for program in "${skipped[@]}"
+do
+    echo "    $program"
+done
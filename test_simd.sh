@@ -0,0 +1,102 @@
+# testing script for the simulation server (simd)
+# make sure this script is in your main working directory
+# (with your .c files etc), build with make and run:
+# ./test_simd.sh
+# if you get permission denied, run
+# chmod +x test_simd.sh
+# and try again
+#
+# starts simd on a private socket with the p1 OS, sends it requests and
+# compares the replies: DONE and FAULT lines, an ERROR that leaves the
+# connection usable, an object sent as an IMAGE, and a streamed trace that
+# has to match the file ./trace writes for the same program.
+
+# function for printing result
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m'
+BOLD='\033[1m'
+NORMAL='\033[0m'
+
+function result() {
+    if [ $1 = "Success" ]; then
+        printf "${GREEN}${BOLD}Success${NC}${NORMAL}\n"
+    fi
+    if [ $1 = "Failure" ]; then
+        printf "${RED}${BOLD}Failure${NC}${NORMAL}\n"
+    fi
+}
+
+# function to send request lines on one connection and print the reply;
+# a line "IMAGE <file.obj>" sends the file as an IMAGE
+# usage: request <socket> <line> ...
+function request() {
+    python3 - "$@" <<'EOF'
+import socket, sys
+conn = socket.socket(socket.AF_UNIX)
+conn.connect(sys.argv[1])
+for line in sys.argv[2:] + ["QUIT"]:
+    if line.startswith("IMAGE "):
+        image = open(line[6:], "rb").read()
+        conn.sendall(("IMAGE %d\n" % len(image)).encode() + image)
+    else:
+        conn.sendall((line + "\n").encode())
+reply = b""
+while True:
+    chunk = conn.recv(65536)
+    if not chunk:
+        break
+    reply += chunk
+sys.stdout.write(reply.decode(errors="replace"))
+EOF
+}
+
+# function to compare a reply with what was expected
+# usage: check <name> <expected> <got>
+function check() {
+    echo "$1"
+    if [ "$2" = "$3" ]; then
+        result "Success"
+    else
+        echo "expected:"
+        echo "$2"
+        echo "got:"
+        echo "$3"
+        result "Failure"
+    fi
+    echo "--------------------------------------------"
+}
+
+work=$(mktemp -d)
+trap 'kill $server 2> /dev/null; rm -rf $work' EXIT
+
+./simd -s $work/simd.sock -w 2 p1_test_cases/os.obj > /dev/null &
+server=$!
+while [ ! -S $work/simd.sock ]; do sleep 0.1; done
+
+echo "--------------------------------------------"
+check "RUN with a PATH" \
+"FAULT Invalid PC, setting to default
+DONE halted 13 80FF 8001 0028 001E 0078 007C 0000 0000 0000 0006" \
+"$(request $work/simd.sock "RUN 1000 off 1" "PATH p1_test_cases/user_square.obj")"
+
+check "RUN with an IMAGE" \
+"FAULT Invalid PC, setting to default
+DONE halted 13 80FF 8001 0028 001E 0078 007C 0000 0000 0000 0006" \
+"$(request $work/simd.sock "RUN 1000 off 1" "IMAGE p1_test_cases/user_square.obj")"
+
+check "RUN 0, a missing object and a fault on one connection" \
+"DONE limit 0 8200 8002 0000 0000 0000 0000 0000 0000 0000 0000
+ERROR could not load $work/missing.obj
+FAULT Invalid memory address
+DONE fault 13 0005 0001 0040 0000 0005 0000 0000 0000 0000 0000" \
+"$(request $work/simd.sock "RUN 0 off 1" "PATH p1_test_cases/user_square.obj" \
+    "RUN 100 off 1" "PATH $work/missing.obj" "RUN 1000 off 1" "PATH p1_test_cases/sum.obj")"
+
+check "cycle limit" \
+"DONE limit 50 0003 0004 00C6 FFFE 00C8 FFFE 0000 0000 0000 0000" \
+"$(request $work/simd.sock "RUN 50 off 1" "PATH p1_test_cases/easy.obj")"
+
+./trace $work/expected.txt p1_test_cases/os.obj p1_test_cases/user_square.obj > /dev/null
+request $work/simd.sock "RUN 1000 on 1" "PATH p1_test_cases/user_square.obj" | grep -v "^FAULT\|^DONE" > $work/streamed.txt
+check "streamed trace matches ./trace" "" "$(diff $work/expected.txt $work/streamed.txt)"
@@ -3,32 +3,209 @@
  */
 
 #include "loader.h"
+#include "pipeline.h"
+#include "cache.h"
+#include "recorder.h"
+#include "profiler.h"
+#include "asm.h"
+#include "shard.h"
+#include <setjmp.h>
+#include <signal.h>
+#include <unistd.h>
 
 // Global variable defining the current state of the machine
 MachineState* CPU;
 
+// Flight recorder, global so it can be dumped after a signal
+FlightRecorder* recorder;
+
+// Set by SIGINT, SIGTERM and SIGABRT, which can arrive in the middle of stdio;
+// the main loop dumps the flight recorder and re-raises the signal
+volatile sig_atomic_t stopSignal = 0;
+
+// SIGSEGV, SIGBUS and SIGFPE come from the instruction being simulated, so
+// there is no loop to get back to; their handler jumps back into main here
+sigjmp_buf crashed;
+
+// dump the flight recorder and die from sig as if it had not been caught
+static void dumpOnSignal(int sig) {
+  char reason[32];
+  snprintf(reason, sizeof(reason), "signal %d", sig);
+  RecorderDump(recorder, CPU, reason, stderr);
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+static void stopOnSignal(int sig) {
+  stopSignal = sig;
+}
+
+// stdio isn't async-signal-safe, so the dump runs after the jump, not here
+static void crashOnSignal(int sig) {
+  siglongjmp(crashed, sig);
+}
+
 int main(int argc, char** argv) {
 
-  if( argc < 3 ) { 
+  // optional timing model, enabled with -p <predictor>
+  PipelineModel pipeline;
+  PipelineModel* pipe = NULL;
+
+  // optional caches, enabled with -i <config> and -d <config>
+  Cache icache;
+  Cache dcache;
+  Cache* ic = NULL;
+  Cache* dc = NULL;
+
+  // -n runs without writing a trace, so no output file is given
+  int traceOff = 0;
+
+  // optional ring of the last cycles, enabled with -f <cycles>
+  FlightRecorder flight;
+
+  // optional call-graph profile, enabled with -g <folded-stacks-file>
+  Profiler profile;
+  Profiler* profiler = NULL;
+  char* foldedName = NULL;
+
+  // -a <output.obj> only assembles a .asm file, like PennSim's as command
+  char* objectName = NULL;
+
+  // -j <workers> runs untraced, then regenerates the trace in segments of
+  // -k <cycles> on that many processes
+  ShardedTrace sharded;
+  ShardedTrace* shard = NULL;
+  int shardWorkers = 0;
+  unsigned long long shardInterval = 100000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:i:d:nf:g:a:j:k:")) != -1) {
+    switch (opt) {
+      case 'p':
+        if (PipelineInit(&pipeline, optarg) == -1) {
+          return -1;
+        }
+        pipe = &pipeline;
+        break;
+      case 'i':
+        if (CacheInit(&icache, "icache", optarg) == -1) {
+          return -1;
+        }
+        ic = &icache;
+        break;
+      case 'd':
+        if (CacheInit(&dcache, "dcache", optarg) == -1) {
+          return -1;
+        }
+        dc = &dcache;
+        break;
+      case 'n':
+        traceOff = 1;
+        break;
+      case 'f':
+        if (RecorderInit(&flight, atoi(optarg)) == -1) {
+          return -1;
+        }
+        recorder = &flight;
+        break;
+      case 'g':
+        foldedName = optarg;
+        break;
+      case 'a':
+        objectName = optarg;
+        break;
+      case 'j':
+        shardWorkers = atoi(optarg);
+        break;
+      case 'k':
+        shardInterval = strtoull(optarg, NULL, 10);
+        break;
+      default:
+        printf("usage: trace [-p not-taken|bimodal|gshare[:bits]] [-i cache-config] [-d cache-config] [-f cycles] [-g folded.txt] output.txt file.obj ...\n");
+        printf("       trace -n [-p ...] [-i ...] [-d ...] [-f ...] [-g ...] file.obj ...\n");
+        printf("       trace -j workers [-k cycles-per-segment] [-p ...] [-i ...] [-d ...] [-f ...] [-g ...] output.txt file.obj ...\n");
+        printf("       trace -a output.obj file.asm\n");
+        printf("file.asm arguments are assembled in memory and loaded like object files\n");
+        printf("cache-config: size=<words>,assoc=<ways>,block=<words>,write=wb|wt,repl=lru|random\n");
+        return -1;
+    }
+  }
+
+  if (objectName != NULL) {
+    if (argc - optind != 1) {
+      printf("-a takes exactly one source file\n");
+      return -1;
+    }
+    FILE* object = fopen(objectName, "wb");
+    if (object == NULL) {
+      printf("could not open %s\n", objectName);
+      return -1;
+    }
+    int result = AssembleFile(argv[optind], object);
+    fclose(object);
+    if (result == -1) {
+      remove(objectName);
+    }
+    return result;
+  }
+
+  if (shardWorkers > 0 && traceOff) {
+    printf("-j writes a trace, so it can't be combined with -n\n");
+    return -1;
+  }
+
+  if( argc - optind < 2 - traceOff ) {
       printf("invalid number of files\n");
 			return -1;
   }
 
-  char* filename = argv[1];
-  FILE *fp = fopen(filename, "w");
-  if (filename == NULL || fp == NULL) {
-    printf("file does not exist\n");
-    fclose(fp);
-    return -1;
+  FILE *fp = NULL;
+  if (!traceOff) {
+    char* filename = argv[optind++];
+    fp = fopen(filename, "w");
+    if (filename == NULL || fp == NULL) {
+      printf("file does not exist\n");
+      fclose(fp);
+      return -1;
+    }
   }
 
   //initialize CPU values to null
   MachineState machine;
   CPU = &machine;
   Reset(CPU);
+  CPU -> icache = ic;
+  CPU -> dcache = dc;
+  CPU -> recorder = recorder;
+  if (recorder != NULL) {
+    signal(SIGINT, stopOnSignal);
+    signal(SIGTERM, stopOnSignal);
+    signal(SIGABRT, stopOnSignal);
+    int crash = sigsetjmp(crashed, 1);
+    if (crash != 0) {
+      dumpOnSignal(crash);
+    }
+    signal(SIGSEGV, crashOnSignal);
+    signal(SIGBUS, crashOnSignal);
+    signal(SIGFPE, crashOnSignal);
+  }
+
+  if (foldedName != NULL) {
+    if (ProfilerInit(&profile, CPU -> PC) == -1) {
+      return -1;
+    }
+    profiler = &profile;
+    SetSymbolHandler(ProfilerAddSymbol, profiler);
+  }
+
+  // fused pairs retire two instructions per step, which the timing model
+  // and the profiler can't replay
+  if (traceOff && pipe == NULL && profiler == NULL && EnableFusion(CPU) == -1) {
+    return -1;
+  }
 
   //check if all files exist and read if they do
-  for (int i = 2; i < argc; i++) {
+  for (int i = optind; i < argc; i++) {
     char* filename = argv[i];
     FILE *test = fopen(filename, "rb");
     if (test == NULL) {
@@ -36,17 +213,94 @@ int main(int argc, char** argv) {
       fclose(test);
       return -1;
     }
-    ReadObjectFile(filename, CPU);
+    fclose(test);
+    size_t length = strlen(filename);
+    if (length > 4 && strcmp(filename + length - 4, ".asm") == 0) {
+      if (AssembleIntoMachine(filename, CPU) == -1) {
+        return -1;
+      }
+    } else {
+      ReadObjectFile(filename, CPU);
+    }
   }
 
-  while (CPU -> PC != 0x80FF) {
-    int result = UpdateMachineState(CPU, fp);
-    if (result == -1) {
-      printf("failed and returned at main");
+  if (shardWorkers > 0) {
+    if (ShardInit(&sharded, CPU, shardInterval) == -1) {
       return -1;
     }
+    shard = &sharded;
+  }
+
+  // a fault ends the run like a halt, so the trace and reports still get written
+  int status = 0;
+  while (CPU -> PC != 0x80FF && !stopSignal) {
+    unsigned short pc = CPU -> PC;
+    unsigned short insn = CPU -> memory[pc];
+    int result = UpdateMachineState(CPU, (shard != NULL) ? NULL : fp);
+    if (result == -1) {
+      printf("failed and returned at main\n");
+      status = -1;
+      break;
+    }
+    if (shard != NULL && ShardStep(shard, CPU, insn) == -1) {
+      status = -1;
+      break;
+    }
+    if (pipe != NULL) {
+      PipelineStep(pipe, pc, insn, CPU -> PC);
+    }
+    if (profiler != NULL) {
+      ProfilerStep(profiler, insn, CPU -> PC);
+    }
+  }
+
+  if (recorder != NULL) {
+    // past the loop nothing checks stopSignal any more
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGABRT, SIG_DFL);
+  }
+  if (stopSignal) {
+    dumpOnSignal(stopSignal);
+  }
+
+  if (shard != NULL) {
+    if (ShardWrite(shard, fp, shardWorkers) == -1) {
+      status = -1;
+    }
+    ShardFree(shard);
+  }
+  if (recorder != NULL) {
+    RecorderDump(recorder, CPU, NULL, stderr);
+    RecorderFree(recorder);
+  }
+  if (pipe != NULL) {
+    PipelineReport(pipe, stdout);
+    PipelineFree(pipe);
+  }
+  if (profiler != NULL) {
+    FILE* folded = fopen(foldedName, "w");
+    if (folded == NULL) {
+      printf("could not open %s\n", foldedName);
+    } else {
+      ProfilerWriteFolded(profiler, folded);
+      fclose(folded);
+    }
+    ProfilerReport(profiler, stdout);
+    ProfilerFree(profiler);
+  }
+  if (ic != NULL) {
+    CacheReport(ic, stdout);
+    CacheFree(ic);
+  }
+  if (dc != NULL) {
+    CacheReport(dc, stdout);
+    CacheFree(dc);
   }
 
-  fclose(fp);
-  return 0;
-}
\ No newline at end of file
+  DisableFusion(CPU);
+  if (fp != NULL) {
+    fclose(fp);
+  }
+  return status;
+}